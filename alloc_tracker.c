@@ -0,0 +1,198 @@
+#include "./alloc_tracker.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+
+static atomic_int tracking;
+static atomic_long live_bytes;
+static atomic_long peak_bytes;
+static atomic_size_t total_bytes;
+static atomic_size_t allocations;
+static atomic_size_t frees;
+static atomic_size_t size_classes[ALLOC_SIZE_CLASSES];
+static __thread int thread_ignored;
+
+size_t alloc_size_class(size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t class = 64 - __builtin_clzll(size);
+    return class < ALLOC_SIZE_CLASSES ? class : ALLOC_SIZE_CLASSES - 1;
+}
+
+void alloc_tracker_start()
+{
+    atomic_store(&tracking, 0);
+    atomic_store(&live_bytes, 0);
+    atomic_store(&peak_bytes, 0);
+    atomic_store(&total_bytes, 0);
+    atomic_store(&allocations, 0);
+    atomic_store(&frees, 0);
+    for (size_t i = 0; i < ALLOC_SIZE_CLASSES; i++) {
+        atomic_store(&size_classes[i], 0);
+    }
+    atomic_store(&tracking, 1);
+}
+
+void alloc_tracker_stop(alloc_stats_t *stats)
+{
+    atomic_store(&tracking, 0);
+
+    long peak = atomic_load(&peak_bytes);
+    stats->peak_bytes = peak > 0 ? peak : 0;
+    stats->total_bytes = atomic_load(&total_bytes);
+    stats->allocations = atomic_load(&allocations);
+    stats->frees = atomic_load(&frees);
+    for (size_t i = 0; i < ALLOC_SIZE_CLASSES; i++) {
+        stats->size_classes[i] = atomic_load(&size_classes[i]);
+    }
+}
+
+void alloc_tracker_ignore_thread(int ignore)
+{
+    thread_ignored = ignore;
+}
+
+#ifdef BENCHMARK_MALLOC_HOOKS
+// glibc's allocator, these are exported so that the wrappers do not need dlsym (which allocates)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+int alloc_tracker_available()
+{
+    return 1;
+}
+
+/// Relaxed ordering is enough as the counts are only read after alloc_tracker_stop
+static void track_alloc(void *ptr, size_t size)
+{
+    if (ptr == NULL || !atomic_load_explicit(&tracking, memory_order_relaxed) || thread_ignored) {
+        return;
+    }
+
+    // The usable size is used so that frees, which do not know the requested size, balance out
+    long usable = malloc_usable_size(ptr);
+    long live = atomic_fetch_add_explicit(&live_bytes, usable, memory_order_relaxed) + usable;
+    long peak = atomic_load_explicit(&peak_bytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(&peak_bytes, &peak, live,
+            memory_order_relaxed, memory_order_relaxed));
+
+    atomic_fetch_add_explicit(&total_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&size_classes[alloc_size_class(size)], 1, memory_order_relaxed);
+}
+
+static void track_free(void *ptr)
+{
+    if (ptr == NULL || !atomic_load_explicit(&tracking, memory_order_relaxed) || thread_ignored) {
+        return;
+    }
+
+    atomic_fetch_sub_explicit(&live_bytes, malloc_usable_size(ptr), memory_order_relaxed);
+    atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+}
+
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    track_alloc(ptr, size);
+    return ptr;
+}
+
+void *calloc(size_t n, size_t size)
+{
+    void *ptr = __libc_calloc(n, size);
+    track_alloc(ptr, n * size);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+
+    // The old block has to be measured before it is (possibly) freed
+    long old_usable = malloc_usable_size(ptr);
+    void *ret = __libc_realloc(ptr, size);
+    if (ret == NULL && size > 0) {
+        return NULL;
+    }
+
+    if (atomic_load_explicit(&tracking, memory_order_relaxed) && !thread_ignored) {
+        atomic_fetch_sub_explicit(&live_bytes, old_usable, memory_order_relaxed);
+        atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    }
+    track_alloc(ret, size);
+    return ret;
+}
+
+void *reallocarray(void *ptr, size_t n, size_t size)
+{
+    size_t total;
+    if (__builtin_mul_overflow(n, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, total);
+}
+
+void free(void *ptr)
+{
+    track_free(ptr);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+    track_alloc(ptr, size);
+    return ptr;
+}
+
+void *valloc(size_t size)
+{
+    void *ptr = __libc_valloc(size);
+    track_alloc(ptr, size);
+    return ptr;
+}
+
+void *pvalloc(size_t size)
+{
+    void *ptr = __libc_pvalloc(size);
+    track_alloc(ptr, size);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void *ptr = memalign(alignment, size);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+#else
+int alloc_tracker_available()
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Size class i holds allocations of [2 ^ (i - 1), 2 ^ i) bytes, class 0 holds 0 byte
+/// allocations and, the last class holds everything that is larger
+#define ALLOC_SIZE_CLASSES 32
+
+/// Exact counts of the allocations that were made while the tracker was running
+typedef struct alloc_stats_t {
+    /// The most bytes that were live at once, relative to when the tracker started
+    size_t peak_bytes;
+    /// The sum of the sizes of all allocations
+    size_t total_bytes;
+    /// malloc, calloc, realloc, posix_memalign, aligned_alloc and, memalign calls
+    size_t allocations;
+    size_t frees;
+    size_t size_classes[ALLOC_SIZE_CLASSES];
+} alloc_stats_t;
+
+/// Whether malloc and, friends are interposed, this needs BENCHMARK_MALLOC_HOOKS to be defined
+/// when the library is compiled. Without it the tracker always reports 0.
+int alloc_tracker_available();
+
+/// Resets the counts and, starts tracking allocations from all threads
+void alloc_tracker_start();
+
+/// Stops tracking, writing the counts since alloc_tracker_start to stats
+void alloc_tracker_stop(alloc_stats_t *stats);
+
+/// Excludes the calling thread from tracking (i.e: profiler threads) if ignore is set
+void alloc_tracker_ignore_thread(int ignore);
+
+/// The size class of an allocation of size bytes
+size_t alloc_size_class(size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,11 +1,24 @@
+#define _GNU_SOURCE
 #include "./bench.h"
 #include "./bench_output.h"
+#include "./bench_binary.h"
 #include "./testing.h/logger.h"
 #include "./time_utils.h"
 #include "./mem_profiler.h"
+#include "./histogram.h"
 #include <time.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 
 int init_benchmark_output_conf(benchmark_output_conf_t *conf, benchmark_output_type_t t, char *name)
 {
@@ -48,145 +61,1840 @@ void free_benchmark_output_conf(benchmark_output_conf_t *conf)
     }
 }
 
-int benchmark_program(benchmark_conf_t *conf_bench, benchmark_profile_t *output_profile)
+/// The running totals of an entry while its runs are done
+typedef struct benchmark_entry_state_t {
+    histogram_t hist;
+    uint64_t total_ns;
+    /// The sum of the time of an operation in each run, see benchmark_batch_conf_t
+    double op_total_ns;
+    /// The sum of the bytes and, items of each operation, see benchmark_throughput_conf_t
+    double bytes_total;
+    double items_total;
+    /// The sum of each perf counter and, the runs that it was counted in
+    double perf_totals[PERF_COUNTERS];
+    size_t perf_runs[PERF_COUNTERS];
+    /// The sum of the allocation counts, peak_bytes is the max
+    alloc_stats_t alloc_totals;
+    /// When the first run started, for the adaptive time budget. When the runs are in blocks this
+    /// is moved forward so that the time between blocks is not counted
+    uint64_t start_ns;
+    /// The time spent in the blocks of runs so far, used when the runs are in blocks
+    uint64_t active_ns;
+    /// Whether the cold and, warm up runs have been done
+    int started;
+    /// Whether the entry has had enough runs
+    int done;
+    /// The space in run_outputs and, run_times_ns
+    size_t outputs_capacity;
+    size_t times_capacity;
+} benchmark_entry_state_t;
+
+/// Used when sysconf cannot find the size of the last level cache
+#define LLC_SIZE_GUESS (32 * 1024 * 1024)
+/// Warm up is steady when the mean of this many runs stops changing
+#define WARMUP_WINDOW 5
+#define CACHE_LINE_SIZE 64
+/// The default time of a batch of iterations
+#define BATCH_TARGET_NS 10000
+#define BATCH_MAX_ITERATIONS ((size_t) 1 << 30)
+/// The overhead of a batch is the least time of this many calls with no iterations
+#define BATCH_OVERHEAD_RUNS 32
+
+/// State that is shared by all of the entries of a benchmark
+typedef struct benchmark_runner_t {
+    benchmark_conf_t *conf;
+    benchmark_timer_t timer;
+    memory_profiler_t mtp;
+    cpu_profiler_t cpt;
+    /// Opened by the thread that runs the entries
+    perf_profiler_t ppt;
+    /// Reused for each entry
+    benchmark_entry_state_t state;
+    /// Reused for the cold runs of each entry
+    histogram_t cold_hist;
+    /// Streamed through to flush the caches before cold runs
+    unsigned char *flush_buffer;
+    size_t flush_size;
+    /// State for the sampling of run times when there are more than max_run_times
+    uint64_t rand_state;
+    /// The time of an operation in the last run, see benchmark_batch_conf_t
+    double last_op_ns;
+} benchmark_runner_t;
+
+/// The size of the last level cache in bytes, a guess is used if it cannot be found
+static size_t llc_size()
+{
+    int levels[] = {_SC_LEVEL4_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE, _SC_LEVEL2_CACHE_SIZE};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(*levels); i++) {
+        long size = sysconf(levels[i]);
+        if (size > 0) {
+            return size;
+        }
+    }
+    return LLC_SIZE_GUESS;
+}
+
+static int init_benchmark_runner(benchmark_runner_t *runner, benchmark_conf_t *conf)
+{
+    runner->conf = conf;
+    runner->rand_state = 0x2545F4914F6CDD1DULL;
+    init_histogram(&runner->state.hist);
+    init_histogram(&runner->cold_hist);
+    runner->flush_buffer = NULL;
+    int perf_started = 0, mem_started = 0;
+    if (!init_benchmark_timer(&runner->timer, conf->timer)) {
+        lprintf(LOG_ERROR, "Cannot init timer\n");
+        goto fail;
+    }
+
+    if (conf->batch_conf.enabled && conf->batch_conf.func == NULL) {
+        lprintf(LOG_ERROR, "Batches need batch_conf.func to be set\n");
+        goto fail;
+    }
+
+    if (conf->cold_conf.enabled) {
+        runner->flush_size = conf->cold_conf.flush_size > 0 ? conf->cold_conf.flush_size : 2 * llc_size();
+        runner->flush_buffer = malloc(runner->flush_size);
+        if (runner->flush_buffer == NULL) {
+            lprintf(LOG_ERROR, "Cannot malloc cache flush buffer\n");
+            goto fail;
+        }
+        memset(runner->flush_buffer, 0, runner->flush_size);
+    }
+
+    if (conf->perf_conf.enabled) {
+        if (!init_perf_profiler(&runner->ppt)) {
+            lprintf(LOG_ERROR, "Cannot start perf profiler\n");
+            goto fail;
+        }
+        perf_started = 1;
+    }
+
+    if (conf->alloc_conf.enabled && !alloc_tracker_available()) {
+        lprintf(LOG_WARNING, "Allocation tracking needs BENCHMARK_MALLOC_HOOKS, allocations will be 0\n");
+    }
+
+    if (conf->mem_conf.enabled) {
+        runner->mtp.poll_time = conf->mem_conf.poll_time;
+        runner->mtp.sample_rss = conf->mem_conf.rss;
+        runner->mtp.sample_pss = conf->mem_conf.pss;
+        runner->mtp.skip_heap = conf->mem_conf.skip_heap;
+        if (!init_memory_profiler(&runner->mtp)) {
+            lprintf(LOG_ERROR, "Cannot start memory profiler\n");
+            goto fail;
+        }
+        mem_started = 1;
+    }
+
+    if (conf->cpu_conf.enabled) {
+        runner->cpt.poll_time = conf->cpu_conf.poll_time;
+        if (!init_cpu_profiler(&runner->cpt)) {
+            lprintf(LOG_ERROR, "Cannot start cpu profiler\n");
+            goto fail;
+        }
+    }
+
+    return 1;
+
+    // Frees whatever was started before the failure, free_benchmark_runner expects all of it
+fail:
+    free_histogram(&runner->state.hist);
+    free_histogram(&runner->cold_hist);
+    free(runner->flush_buffer);
+    runner->flush_buffer = NULL;
+    if (perf_started) {
+        free_perf_profiler(&runner->ppt);
+    }
+    if (mem_started) {
+        free_memory_profiler(&runner->mtp);
+    }
+    return 0;
+}
+
+static void free_benchmark_runner(benchmark_runner_t *runner)
+{
+    free_histogram(&runner->state.hist);
+    free_histogram(&runner->cold_hist);
+    if (runner->flush_buffer != NULL) {
+        free(runner->flush_buffer);
+    }
+    if (runner->conf->mem_conf.enabled) {
+        free_memory_profiler(&runner->mtp);
+    }
+    if (runner->conf->cpu_conf.enabled) {
+        free_cpu_profiler(&runner->cpt);
+    }
+    if (runner->conf->perf_conf.enabled) {
+        free_perf_profiler(&runner->ppt);
+    }
+}
+
+/// Calls the function that is being benchmarked once, iterations is only used for batches
+static int call_benchmark_func(benchmark_conf_t *conf, vector_t params, size_t iterations)
+{
+    if (conf->batch_conf.enabled) {
+        return conf->batch_conf.func(conf->fixture_conf.ctx, params, iterations);
+    }
+    if (conf->fixture_conf.func != NULL) {
+        return conf->fixture_conf.func(conf->fixture_conf.ctx, params);
+    }
+    if (conf->function_type == FUNC_NO_PARAM) {
+        return conf->np_func();
+    }
+    return conf->p_func(params);
+}
+
+/// The amount of runs that are expected to be done for an entry
+static size_t planned_runs(benchmark_conf_t *conf)
+{
+    if (conf->adaptive_conf.enabled) {
+        return conf->adaptive_conf.min_runs;
+    }
+    return conf->runs_to_average;
+}
+
+/// The most runs that can be done for an entry
+static size_t max_runs(benchmark_conf_t *conf)
+{
+    if (conf->adaptive_conf.enabled) {
+        return conf->adaptive_conf.max_runs;
+    }
+    return conf->runs_to_average;
+}
+
+/// The most run times that are stored for an entry
+static size_t max_stored_run_times(benchmark_conf_t *conf)
+{
+    size_t runs = max_runs(conf);
+    if (conf->max_run_times > 0 && conf->max_run_times < runs) {
+        return conf->max_run_times;
+    }
+    return runs;
+}
+
+/// Grows the per run arrays of an entry so that they have space for at least runs runs
+static int grow_benchmark_entry(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                benchmark_entry_state_t *state, size_t runs)
+{
+    benchmark_conf_t *conf = runner->conf;
+    if (runs > max_runs(conf)) {
+        runs = max_runs(conf);
+    }
+
+    size_t times = runs < max_stored_run_times(conf) ? runs : max_stored_run_times(conf);
+    if (times > state->times_capacity || entry->run_times_ns == NULL) {
+        uint64_t *tmp = realloc(entry->run_times_ns, sizeof(*entry->run_times_ns) * (times > 0 ? times : 1));
+        if (tmp == NULL) {
+            lprintf(LOG_ERROR, "Cannot allocate run times array\n");
+            return 0;
+        }
+        entry->run_times_ns = tmp;
+        state->times_capacity = times;
+    }
+
+    if (conf->monitor_func_output && (runs > state->outputs_capacity || entry->run_outputs == NULL)) {
+        int *tmp = realloc(entry->run_outputs, sizeof(*entry->run_outputs) * (runs > 0 ? runs : 1));
+        if (tmp == NULL) {
+            lprintf(LOG_ERROR, "Cannot allocate run outputs array\n");
+            return 0;
+        }
+        entry->run_outputs = tmp;
+        state->outputs_capacity = runs;
+    }
+
+    return 1;
+}
+
+/// Allocates the per core breakdown of an entry if the cpu profile is enabled
+static int init_cpu_core_usage(benchmark_runner_t *runner, benchmark_profile_entry_t *entry)
+{
+    if (!runner->conf->cpu_conf.enabled) {
+        return 1;
+    }
+
+    entry->cpu_cores = runner->cpt.cores;
+    entry->cpu_core_usage_us = calloc(runner->cpt.cores, sizeof(*entry->cpu_core_usage_us));
+    if (entry->cpu_core_usage_us == NULL) {
+        lprintf(LOG_ERROR, "Cannot allocate cpu core usage array\n");
+        return 0;
+    }
+    return 1;
+}
+
+/// Resets the entry and, its state then allocates the per run arrays
+static int init_benchmark_entry(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                benchmark_entry_state_t *state, vector_t params)
+{
+    benchmark_conf_t *conf = runner->conf;
+    memset(entry, 0, sizeof(*entry));
+    entry->params = params;
+
+    reset_histogram(&state->hist);
+    state->total_ns = 0;
+    state->op_total_ns = 0;
+    state->bytes_total = 0;
+    state->items_total = 0;
+    memset(state->perf_totals, 0, sizeof(state->perf_totals));
+    memset(state->perf_runs, 0, sizeof(state->perf_runs));
+    memset(&state->alloc_totals, 0, sizeof(state->alloc_totals));
+    state->start_ns = time_now_ns();
+    state->active_ns = 0;
+    state->started = state->done = 0;
+    state->outputs_capacity = state->times_capacity = 0;
+
+    if (!grow_benchmark_entry(runner, entry, state, planned_runs(conf))) {
+        return 0;
+    }
+
+    return init_cpu_core_usage(runner, entry);
+}
+
+/// Adds the cpu profile since the last calibration to the totals of an entry
+static void add_cpu_core_usage(benchmark_profile_entry_t *entry, cpu_profiler_t *cpt)
+{
+    entry->cpu_core_time_us += cpu_core_time_us(cpt);
+
+    size_t cores[cpt->cores];
+    if (cpu_per_core_time_us(cpt, cores)) {
+        for (size_t i = 0; i < cpt->cores; i++) {
+            entry->cpu_core_usage_us[i] += cores[i];
+        }
+    }
+}
+
+/// xorshift64*, this only needs to be fast and, not correlated with the runs
+static uint64_t runner_rand(benchmark_runner_t *runner)
+{
+    uint64_t x = runner->rand_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    runner->rand_state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/// Stores the time of run i, when there are more runs than space a reservoir sample is kept
+static void record_run_time(benchmark_runner_t *runner, benchmark_profile_entry_t *entry, size_t i, uint64_t ns)
+{
+    if (i < max_stored_run_times(runner->conf)) {
+        entry->run_times_ns[i] = ns;
+        entry->run_times_len = i + 1;
+        return;
+    }
+
+    size_t j = runner_rand(runner) % (i + 1);
+    if (j < entry->run_times_len) {
+        entry->run_times_ns[j] = ns;
+    }
+}
+
+static void fill_benchmark_stats(benchmark_stats_t *stats, histogram_t *hist)
+{
+    stats->min = hist->min;
+    stats->max = hist->max;
+    stats->mean = hist->mean;
+    stats->stddev = histogram_stddev(hist);
+    stats->p50 = histogram_percentile(hist, 50);
+    stats->p90 = histogram_percentile(hist, 90);
+    stats->p99 = histogram_percentile(hist, 99);
+    stats->p999 = histogram_percentile(hist, 99.9);
+    stats->mad = histogram_mad(hist);
+}
+
+/// What the function that is being timed on this thread has reported, reset before each call
+static __thread size_t reported_bytes;
+static __thread size_t reported_items;
+
+void benchmark_report_bytes(size_t bytes)
+{
+    reported_bytes += bytes;
+}
+
+void benchmark_report_items(size_t items)
+{
+    reported_items += items;
+}
+
+/// Calls the function that is being benchmarked once, returning the time that it took in ns
+static uint64_t time_benchmark_call(benchmark_runner_t *runner, vector_t params, size_t iterations, int *output)
+{
+    reported_bytes = reported_items = 0;
+
+    // The barriers keep the setup out of the timed region and, the result of the function alive
+    BENCHMARK_CLOBBER_MEMORY();
+    uint64_t start = benchmark_timer_read(&runner->timer);
+    *output = call_benchmark_func(runner->conf, params, iterations);
+    BENCHMARK_DO_NOT_OPTIMIZE(*output);
+    uint64_t end = benchmark_timer_read(&runner->timer);
+    return benchmark_timer_ns(&runner->timer, start, end);
+}
+
+/// Does a run of an entry, returning the time that it took in ns. For batches this is the time of
+/// the whole batch without the overhead, runner->last_op_ns has the time of an iteration
+static uint64_t time_benchmark_func(benchmark_runner_t *runner, benchmark_profile_entry_t *entry, int *output)
+{
+    uint64_t ns = time_benchmark_call(runner, entry->params, entry->batch_iterations, output);
+    if (!runner->conf->batch_conf.enabled) {
+        runner->last_op_ns = ns;
+        return ns;
+    }
+
+    // An iteration can take less than a ns so the batch is kept whole, it is only split for op_time_ns
+    double batch_ns = ns > entry->batch_overhead_ns ? ns - entry->batch_overhead_ns : 0;
+    runner->last_op_ns = batch_ns / entry->batch_iterations;
+    return llround(batch_ns);
+}
+
+/// Calls the fixture setup before a block of runs of an entry, 0 on failure
+static int setup_benchmark_fixture(benchmark_conf_t *conf, vector_t params)
+{
+    benchmark_fixture_conf_t *fixture = &conf->fixture_conf;
+    if (fixture->setup != NULL && !fixture->setup(fixture->ctx, params)) {
+        lprintf(LOG_ERROR, "Fixture setup failed\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void teardown_benchmark_fixture(benchmark_conf_t *conf, vector_t params)
+{
+    benchmark_fixture_conf_t *fixture = &conf->fixture_conf;
+    if (fixture->teardown != NULL) {
+        fixture->teardown(fixture->ctx, params);
+    }
+}
+
+/// Calls the fixture setup before a run, 0 on failure
+static int setup_benchmark_run(benchmark_conf_t *conf, vector_t params)
+{
+    benchmark_fixture_conf_t *fixture = &conf->fixture_conf;
+    if (fixture->run_setup != NULL && !fixture->run_setup(fixture->ctx, params)) {
+        lprintf(LOG_ERROR, "Fixture run setup failed\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void teardown_benchmark_run(benchmark_conf_t *conf, vector_t params)
+{
+    benchmark_fixture_conf_t *fixture = &conf->fixture_conf;
+    if (fixture->run_teardown != NULL) {
+        fixture->run_teardown(fixture->ctx, params);
+    }
+}
+
+/// Does an unrecorded run with the per run fixture, 0 on failure
+static int untracked_benchmark_run(benchmark_runner_t *runner, benchmark_profile_entry_t *entry, uint64_t *ns)
+{
+    if (!setup_benchmark_run(runner->conf, entry->params)) {
+        return 0;
+    }
+
+    int s;
+    *ns = time_benchmark_func(runner, entry, &s);
+    teardown_benchmark_run(runner->conf, entry->params);
+    return 1;
+}
+
+/// Times an unrecorded batch of iterations with the per run fixture, UINT64_MAX on failure
+static uint64_t time_benchmark_batch(benchmark_runner_t *runner, vector_t params, size_t iterations)
+{
+    if (!setup_benchmark_run(runner->conf, params)) {
+        return UINT64_MAX;
+    }
+
+    int s;
+    uint64_t ns = time_benchmark_call(runner, params, iterations, &s);
+    teardown_benchmark_run(runner->conf, params);
+    return ns;
+}
+
+/// Finds the overhead of a call of the batch function and, the iterations that make a run take
+/// batch_conf.target_ns for an entry, 0 on failure
+static int calibrate_benchmark_batch(benchmark_runner_t *runner, benchmark_profile_entry_t *entry)
+{
+    benchmark_batch_conf_t *batch = &runner->conf->batch_conf;
+    uint64_t overhead = UINT64_MAX;
+    for (size_t i = 0; i < BATCH_OVERHEAD_RUNS; i++) {
+        uint64_t ns = time_benchmark_batch(runner, entry->params, 0);
+        if (ns == UINT64_MAX) {
+            return 0;
+        }
+        overhead = ns < overhead ? ns : overhead;
+    }
+    entry->batch_overhead_ns = overhead;
+
+    if (batch->iterations > 0) {
+        entry->batch_iterations = batch->iterations;
+        return 1;
+    }
+
+    // Grow the batch by how far it is from the target with a margin, it grows by at most 10x at a
+    // time as the first batches are the noisiest
+    size_t target = batch->target_ns > 0 ? batch->target_ns : BATCH_TARGET_NS;
+    size_t iterations = 1;
+    while (iterations < BATCH_MAX_ITERATIONS) {
+        uint64_t ns = time_benchmark_batch(runner, entry->params, iterations);
+        if (ns == UINT64_MAX) {
+            return 0;
+        }
+
+        ns = ns > overhead ? ns - overhead : 0;
+        if (ns >= target) {
+            break;
+        }
+
+        double factor = ns > 0 ? 1.4 * target / ns : 10;
+        factor = factor > 10 ? 10 : factor < 2 ? 2 : factor;
+        iterations *= factor;
+    }
+
+    entry->batch_iterations = iterations < BATCH_MAX_ITERATIONS ? iterations : BATCH_MAX_ITERATIONS;
+    return 1;
+}
+
+/// Evicts the benchmark's data from the caches by writing to every line of a buffer that is
+/// larger than the LLC
+static void flush_caches(benchmark_runner_t *runner)
+{
+    volatile unsigned char *buffer = runner->flush_buffer;
+    for (size_t i = 0; i < runner->flush_size; i += CACHE_LINE_SIZE) {
+        buffer[i]++;
+    }
+}
+
+/// Does the cold runs of an entry, these are only timed
+static int benchmark_entry_cold_runs(benchmark_runner_t *runner, benchmark_profile_entry_t *entry)
+{
+    reset_histogram(&runner->cold_hist);
+    for (size_t i = 0; i < runner->conf->cold_conf.runs; i++) {
+        // The setup is before the flush as it may touch the data that is used
+        if (!setup_benchmark_run(runner->conf, entry->params)) {
+            return 0;
+        }
+        flush_caches(runner);
+
+        int s;
+        uint64_t ns = time_benchmark_func(runner, entry, &s);
+        teardown_benchmark_run(runner->conf, entry->params);
+        if (!histogram_record(&runner->cold_hist, ns)) {
+            return 0;
+        }
+        entry->cold_runs++;
+    }
+
+    fill_benchmark_stats(&entry->cold_time_stats, &runner->cold_hist);
+    return 1;
+}
+
+/// Does the warm up runs of an entry, these are not recorded
+static int benchmark_entry_warmup(benchmark_runner_t *runner, benchmark_profile_entry_t *entry)
+{
+    benchmark_warmup_conf_t *warmup = &runner->conf->warmup_conf;
+    uint64_t ns;
+    for (size_t i = 0; i < warmup->runs; i++) {
+        if (!untracked_benchmark_run(runner, entry, &ns)) {
+            return 0;
+        }
+        entry->warmup_runs++;
+    }
+
+    if (!warmup->until_steady) {
+        return 1;
+    }
+
+    // Compare the mean of each window of runs to the last one
+    double last_mean = 0;
+    while (entry->warmup_runs < warmup->max_runs) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < WARMUP_WINDOW; i++) {
+            if (!untracked_benchmark_run(runner, entry, &ns)) {
+                return 0;
+            }
+            total += ns;
+        }
+        entry->warmup_runs += WARMUP_WINDOW;
+
+        double mean = (double) total / WARMUP_WINDOW;
+        if (last_mean > 0 && fabs(mean - last_mean) / last_mean <= warmup->steady_threshold) {
+            return 1;
+        }
+        last_mean = mean;
+    }
+    return 1;
+}
+
+/// Adds the memory profile of a run to the totals of an entry
+static void add_memory_usage(benchmark_profile_entry_t *entry, memory_profiler_t *mtp)
+{
+    memory_usage_t usage;
+    memory_profiler_usage(mtp, &usage);
+    entry->max_mem_usage += usage.heap;
+    entry->max_rss_usage += usage.rss;
+    entry->max_pss_usage += usage.pss;
+    entry->minor_faults += usage.minor_faults;
+    entry->major_faults += usage.major_faults;
+}
+
+/// Adds the allocations of a run to the totals of an entry
+static void add_alloc_stats(alloc_stats_t *totals, alloc_stats_t *run)
+{
+    if (run->peak_bytes > totals->peak_bytes) {
+        totals->peak_bytes = run->peak_bytes;
+    }
+    totals->total_bytes += run->total_bytes;
+    totals->allocations += run->allocations;
+    totals->frees += run->frees;
+    for (size_t i = 0; i < ALLOC_SIZE_CLASSES; i++) {
+        totals->size_classes[i] += run->size_classes[i];
+    }
+}
+
+/// Adds the bytes and, items that the last run reported to the totals of an entry, the amounts
+/// from the params are found once per entry in finish_benchmark_throughput
+static void add_benchmark_throughput(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                     benchmark_entry_state_t *state)
+{
+    // What is reported is for the whole call, which is every iteration of a batch
+    double iterations = runner->conf->batch_conf.enabled ? entry->batch_iterations : 1;
+    state->bytes_total += (double) reported_bytes / iterations;
+    state->items_total += (double) reported_items / iterations;
+}
+
+/// Sets the bytes and, items per operation of an entry. The throughput functions only depend on
+/// the params so they are called once here, outside of the profiles of the runs
+static void finish_benchmark_throughput(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                        benchmark_entry_state_t *state, size_t runs)
+{
+    benchmark_throughput_conf_t *throughput = &runner->conf->throughput_conf;
+    entry->bytes_per_op = throughput->bytes != NULL ? throughput->bytes(entry->params) : state->bytes_total / runs;
+    entry->items_per_op = throughput->items != NULL ? throughput->items(entry->params) : state->items_total / runs;
+}
+
+/// Sets the rates of an entry from its op_time_ns, bytes_per_op and, items_per_op
+static void set_benchmark_throughput(benchmark_profile_entry_t *entry)
+{
+    if (entry->op_time_ns <= 0) {
+        return;
+    }
+
+    // Bytes per ns is GB/s
+    entry->gb_per_s = entry->bytes_per_op / entry->op_time_ns;
+    entry->items_per_s = entry->items_per_op * 1e9 / entry->op_time_ns;
+    if (entry->items_per_op > 0) {
+        entry->ns_per_item = entry->op_time_ns / entry->items_per_op;
+    }
+}
+
+/// Does one run of an entry, the profilers are reset before the run and,
+/// only the call to the function is timed
+static int benchmark_entry_run(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                               benchmark_entry_state_t *state)
+{
+    benchmark_conf_t *conf = runner->conf;
+    size_t i = entry->runs;
+    int full_times = i < max_stored_run_times(conf) && i >= state->times_capacity;
+    int full_outputs = conf->monitor_func_output && i >= state->outputs_capacity;
+    if (full_times || full_outputs) {
+        if (!grow_benchmark_entry(runner, entry, state, i == 0 ? 1 : i * 2)) {
+            return 0;
+        }
+    }
+
+    // The per run setup is before the profilers are reset so it is not measured
+    if (!setup_benchmark_run(conf, entry->params)) {
+        return 0;
+    }
+
+    // Reset profilers state, reading /proc allocates so the cpu profile is calibrated before the
+    // memory profile and, read after it
+    if (conf->cpu_conf.enabled) {
+        calibrate_cpu_profiler(&runner->cpt);
+    }
+    if (conf->mem_conf.enabled) {
+        calibrate_memory_profiler(&runner->mtp);
+    }
+
+    // Run the benchmark run
+    if (conf->perf_conf.enabled) {
+        start_perf_profiler(&runner->ppt);
+    }
+    if (conf->alloc_conf.enabled) {
+        alloc_tracker_start();
+    }
+
+    int s;
+    uint64_t ns = time_benchmark_func(runner, entry, &s);
+    double op_ns = runner->last_op_ns;
+    add_benchmark_throughput(runner, entry, state);
+
+    if (conf->alloc_conf.enabled) {
+        alloc_stats_t allocs;
+        alloc_tracker_stop(&allocs);
+        add_alloc_stats(&state->alloc_totals, &allocs);
+    }
+
+    if (conf->perf_conf.enabled) {
+        uint64_t counters[PERF_COUNTERS];
+        if (!stop_perf_profiler(&runner->ppt, counters)) {
+            return 0;
+        }
+        for (size_t j = 0; j < PERF_COUNTERS; j++) {
+            if (runner->ppt.counted & (1 << j)) {
+                state->perf_totals[j] += counters[j];
+                state->perf_runs[j]++;
+            }
+        }
+    }
+
+    // The profiles are read before the run is recorded, which may allocate
+    if (conf->mem_conf.enabled) {
+        add_memory_usage(entry, &runner->mtp);
+    }
+    if (conf->cpu_conf.enabled) {
+        add_cpu_core_usage(entry, &runner->cpt);
+    }
+
+    record_run_time(runner, entry, i, ns);
+    if (!histogram_record(&state->hist, ns)) {
+        return 0;
+    }
+    state->total_ns += ns;
+    state->op_total_ns += op_ns;
+    teardown_benchmark_run(conf, entry->params);
+
+    if (conf->monitor_func_output) {
+        entry->run_outputs[i] = s;
+        entry->run_outputs_len = i + 1;
+    }
+
+    entry->runs++;
+    return 1;
+}
+
+/// Whether an entry has had enough runs, for adaptive benchmarks this is when the 95%
+/// confidence interval of the mean is narrow enough, or a limit has been hit
+static int benchmark_entry_done(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                benchmark_entry_state_t *state)
+{
+    benchmark_conf_t *conf = runner->conf;
+    if (!conf->adaptive_conf.enabled) {
+        return entry->runs >= conf->runs_to_average;
+    }
+
+    benchmark_adaptive_conf_t *adaptive = &conf->adaptive_conf;
+    if (entry->runs >= adaptive->max_runs) {
+        return 1;
+    }
+    if (entry->runs < adaptive->min_runs || entry->runs < 2) {
+        return 0;
+    }
+
+    double mean = state->hist.mean;
+    double half_width = 1.96 * histogram_stddev(&state->hist) / sqrt(entry->runs);
+    // A target of 0 never stops early so the runs go on to max_runs or, the time budget
+    if (adaptive->target_rel_ci > 0 && (mean <= 0 || 2 * half_width / mean <= adaptive->target_rel_ci)) {
+        entry->converged = 1;
+        return 1;
+    }
+
+    return adaptive->time_budget > 0
+           && time_now_ns() - state->start_ns >= (uint64_t) adaptive->time_budget * 1000 * 1000;
+}
+
+/// Turns the totals of an entry into averages
+static void finish_benchmark_entry(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                   benchmark_entry_state_t *state)
+{
+    size_t runs = entry->runs > 0 ? entry->runs : 1;
+    entry->cpu_time_ns = state->total_ns / runs;
+    entry->op_time_ns = state->op_total_ns / runs;
+    entry->cpu_time_us = entry->cpu_time_ns / 1000;
+    finish_benchmark_throughput(runner, entry, state, runs);
+    set_benchmark_throughput(entry);
+    fill_benchmark_stats(&entry->time_stats, &state->hist);
+    entry->max_mem_usage /= runs;
+    entry->max_rss_usage /= runs;
+    entry->max_pss_usage /= runs;
+    entry->minor_faults /= runs;
+    entry->major_faults /= runs;
+    entry->cpu_core_time_us /= runs;
+    for (size_t i = 0; i < entry->cpu_cores; i++) {
+        entry->cpu_core_usage_us[i] /= runs;
+    }
+
+    if (runner->conf->perf_conf.enabled) {
+        benchmark_perf_t *perf = &entry->perf;
+        // Counters that were never counted are unavailable instead of 0
+        perf->available = 0;
+        for (size_t i = 0; i < PERF_COUNTERS; i++) {
+            if (state->perf_runs[i] > 0) {
+                perf->available |= 1 << i;
+                perf->counters[i] = state->perf_totals[i] / state->perf_runs[i];
+            }
+        }
+        if ((perf->available & (1 << PERF_INSTRUCTIONS)) && perf->counters[PERF_CYCLES] > 0) {
+            perf->ipc = perf->counters[PERF_INSTRUCTIONS] / perf->counters[PERF_CYCLES];
+        }
+    }
+
+    if (runner->conf->alloc_conf.enabled) {
+        benchmark_alloc_t *allocs = &entry->allocs;
+        alloc_stats_t *totals = &state->alloc_totals;
+        allocs->peak_bytes = totals->peak_bytes;
+        allocs->total_bytes = (double) totals->total_bytes / runs;
+        allocs->allocations = (double) totals->allocations / runs;
+        allocs->frees = (double) totals->frees / runs;
+        for (size_t i = 0; i < ALLOC_SIZE_CLASSES; i++) {
+            allocs->size_classes[i] = (double) totals->size_classes[i] / runs;
+        }
+    }
+}
+
+/// Does the cold and, warm up runs of an entry before its first measured run
+static int start_benchmark_entry(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                 benchmark_entry_state_t *state)
+{
+    if (runner->conf->batch_conf.enabled && !calibrate_benchmark_batch(runner, entry)) {
+        return 0;
+    }
+    if (runner->conf->cold_conf.enabled && !benchmark_entry_cold_runs(runner, entry)) {
+        return 0;
+    }
+    if (!benchmark_entry_warmup(runner, entry)) {
+        return 0;
+    }
+    state->start_ns = time_now_ns();
+    state->started = 1;
+    return 1;
+}
+
+/// Runs all of the runs for an entry, params are owned by the profile
+static int run_benchmark_entry(benchmark_runner_t *runner, benchmark_profile_entry_t *entry, vector_t params)
+{
+    benchmark_entry_state_t *state = &runner->state;
+    if (!init_benchmark_entry(runner, entry, state, params)) {
+        return 0;
+    }
+
+    if (!setup_benchmark_fixture(runner->conf, params)) {
+        return 0;
+    }
+
+    int ret = start_benchmark_entry(runner, entry, state);
+    while (ret && !benchmark_entry_done(runner, entry, state)) {
+        ret = benchmark_entry_run(runner, entry, state);
+    }
+    teardown_benchmark_fixture(runner->conf, params);
+
+    if (ret) {
+        finish_benchmark_entry(runner, entry, state);
+    }
+    return ret;
+}
+
+/// Frees the per run arrays of an entry, the params are owned by the profile
+static void free_benchmark_entry(benchmark_profile_entry_t *entry)
+{
+    if (entry->run_outputs != NULL) {
+        free(entry->run_outputs);
+        entry->run_outputs = NULL;
+    }
+    if (entry->run_times_ns != NULL) {
+        free(entry->run_times_ns);
+        entry->run_times_ns = NULL;
+    }
+    if (entry->cpu_core_usage_us != NULL) {
+        free(entry->cpu_core_usage_us);
+        entry->cpu_core_usage_us = NULL;
+    }
+}
+
+const char *benchmark_entry_status_name(benchmark_entry_status_t status)
+{
+    switch (status) {
+    case ENTRY_OK:
+        return "ok";
+    case ENTRY_CRASHED:
+        return "crashed";
+    case ENTRY_TIMED_OUT:
+        return "timed_out";
+    case ENTRY_FAILED:
+        return "failed";
+    }
+    return "unknown";
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const char *ptr = data;
+    while (len > 0) {
+        ssize_t w = write(fd, ptr, len);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return 0;
+        }
+        ptr += w;
+        len -= w;
+    }
+    return 1;
+}
+
+static void set_isolated_limit(int resource, size_t limit)
+{
+    struct rlimit rlim;
+    rlim.rlim_cur = rlim.rlim_max = limit;
+    if (setrlimit(resource, &rlim) != 0) {
+        lprintf(LOG_WARNING, "Cannot set the resource limits of an isolated entry\n");
+    }
+}
+
+/// Runs an entry in the forked child and, writes it to fd. The entry, then its run times, run
+/// outputs and, per core usage are written. This never returns.
+static void benchmark_isolated_child(benchmark_conf_t *conf, vector_t params, int fd)
+{
+    benchmark_isolation_conf_t *isolation = &conf->isolation_conf;
+    set_isolated_limit(RLIMIT_CORE, 0);
+    if (isolation->max_memory > 0) {
+        set_isolated_limit(RLIMIT_AS, isolation->max_memory);
+    }
+    if (isolation->max_cpu_s > 0) {
+        set_isolated_limit(RLIMIT_CPU, isolation->max_cpu_s);
+    }
+
+    // The profiler threads of the parent are not in the child so everything is started again,
+    // nothing is freed as the process exits
+    benchmark_runner_t runner;
+    benchmark_profile_entry_t entry;
+    int ret = init_benchmark_runner(&runner, conf) && run_benchmark_entry(&runner, &entry, params);
+    ret = ret && write_all(fd, &entry, sizeof(entry))
+          && write_all(fd, entry.run_times_ns, sizeof(*entry.run_times_ns) * entry.run_times_len)
+          && write_all(fd, entry.run_outputs, sizeof(*entry.run_outputs) * entry.run_outputs_len)
+          && write_all(fd, entry.cpu_core_usage_us, sizeof(*entry.cpu_core_usage_us) * entry.cpu_cores);
+
+    // _exit does not flush so the logs of the child are flushed here
+    fflush(NULL);
+    _exit(ret ? 0 : 1);
+}
+
+/// Reads everything from fd into a buffer until it is closed, 0 if the timeout is reached first and,
+/// -1 on error
+static int read_isolated_output(int fd, size_t timeout_ms, char **buffer, size_t *len)
+{
+    uint64_t deadline_ns = time_now_ns() + timeout_ms * 1000000;
+    size_t capacity = 0;
+    *buffer = NULL;
+    *len = 0;
+    for (;;) {
+        int wait_ms = -1;
+        if (timeout_ms > 0) {
+            uint64_t now_ns = time_now_ns();
+            if (now_ns >= deadline_ns) {
+                return 0;
+            }
+            wait_ms = (deadline_ns - now_ns + 999999) / 1000000;
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int r = poll(&pfd, 1, wait_ms);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r == 0) {
+            return 0;
+        }
+
+        if (*len == capacity) {
+            capacity = capacity == 0 ? BUFFER_LENGTH : capacity * 2;
+            char *new_buffer = realloc(*buffer, capacity);
+            if (new_buffer == NULL) {
+                lprintf(LOG_ERROR, "Cannot realloc isolated entry buffer\n");
+                return -1;
+            }
+            *buffer = new_buffer;
+        }
+
+        ssize_t n = read(fd, *buffer + *len, capacity - *len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            return 1;
+        }
+        *len += n;
+    }
+}
+
+/// Copies len items of size bytes from the buffer into a new array, NULL if it is too short
+static void *unpack_isolated_array(const char **ptr, const char *end, size_t len, size_t size)
+{
+    if (len > (size_t) (end - *ptr) / size) {
+        return NULL;
+    }
+
+    void *arr = malloc(len * size > 0 ? len * size : 1);
+    if (arr != NULL) {
+        memcpy(arr, *ptr, len * size);
+        *ptr += len * size;
+    }
+    return arr;
+}
+
+/// Reads the output of benchmark_isolated_child into entry, 0 if it is not complete
+static int unpack_isolated_entry(benchmark_profile_entry_t *entry, const char *buffer, size_t len)
+{
+    if (buffer == NULL || len < sizeof(*entry)) {
+        return 0;
+    }
+
+    vector_t params = entry->params;
+    memcpy(entry, buffer, sizeof(*entry));
+    entry->params = params;
+    entry->run_outputs = NULL;
+    entry->cpu_core_usage_us = NULL;
+
+    const char *ptr = buffer + sizeof(*entry), *end = buffer + len;
+    entry->run_times_ns = unpack_isolated_array(&ptr, end, entry->run_times_len, sizeof(*entry->run_times_ns));
+    if (entry->run_times_ns != NULL) {
+        entry->run_outputs = unpack_isolated_array(&ptr, end, entry->run_outputs_len, sizeof(*entry->run_outputs));
+    }
+    if (entry->run_outputs != NULL) {
+        entry->cpu_core_usage_us = unpack_isolated_array(&ptr, end, entry->cpu_cores, sizeof(*entry->cpu_core_usage_us));
+    }
+    if (entry->cpu_core_usage_us == NULL || ptr != end) {
+        free_benchmark_entry(entry);
+        return 0;
+    }
+    return 1;
+}
+
+/// Runs an entry in a forked child, see benchmark_isolation_conf_t. An entry that crashes, times out
+/// or, fails is recorded with that status, 0 is only returned if the child cannot be started
+static int run_isolated_entry(benchmark_conf_t *conf, benchmark_profile_entry_t *entry, vector_t params)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->params = params;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        lprintf(LOG_ERROR, "Cannot create pipe for isolated entry\n");
+        return 0;
+    }
+
+    // Anything that is buffered would be written by both processes otherwise
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        lprintf(LOG_ERROR, "Cannot fork for isolated entry\n");
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        benchmark_isolated_child(conf, params, fds[1]);
+    }
+
+    close(fds[1]);
+    char *buffer;
+    size_t len;
+    int finished = read_isolated_output(fds[0], conf->isolation_conf.timeout_ms, &buffer, &len);
+    close(fds[0]);
+    if (finished != 1) {
+        kill(pid, SIGKILL);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+    if (finished == 0) {
+        entry->status = ENTRY_TIMED_OUT;
+    } else if (finished < 0) {
+        entry->status = ENTRY_FAILED;
+    } else if (WIFSIGNALED(status)) {
+        entry->status = ENTRY_CRASHED;
+        entry->signal = WTERMSIG(status);
+    } else if (WEXITSTATUS(status) != 0 || !unpack_isolated_entry(entry, buffer, len)) {
+        entry->status = ENTRY_FAILED;
+    }
+    free(buffer);
+
+    if (entry->status != ENTRY_OK) {
+        lprintf(LOG_WARNING, "Isolated entry %s\n", benchmark_entry_status_name(entry->status));
+    }
+    return 1;
+}
+
+/// Shared state of the threads of a FUNC_PARALLEL entry
+typedef struct benchmark_scaling_run_t {
+    benchmark_runner_t *runner;
+    benchmark_profile_entry_t *entry;
+    size_t threads;
+    /// The number of run times that each thread can store in entry->run_times_ns
+    size_t times_per_thread;
+    /// The threads wait on this until go is set, 1 once all of them have started or, -1 if one of
+    /// them could not be so the started threads return without running
+    pthread_mutex_t lock;
+    pthread_cond_t started;
+    int go;
+    /// Releases all of the threads at once
+    pthread_barrier_t barrier;
+} benchmark_scaling_run_t;
+
+/// A thread of a FUNC_PARALLEL entry
+typedef struct benchmark_scaling_thread_t {
+    pthread_t thread;
+    size_t id;
+    benchmark_scaling_run_t *run;
+    histogram_t hist;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int failed;
+} benchmark_scaling_thread_t;
+
+static void *benchmark_scaling_thread(void *thread_raw)
 {
-    // Init output
-    output_profile->conf = *conf_bench;
-    output_profile->len = 0;
-    output_profile->entries = malloc (sizeof(*output_profile->entries));
-    if (output_profile->entries == NULL) {
+    benchmark_scaling_thread_t *thread = (benchmark_scaling_thread_t *) thread_raw;
+    benchmark_scaling_run_t *run = thread->run;
+    benchmark_conf_t *conf = run->runner->conf;
+    benchmark_profile_entry_t *entry = run->entry;
+
+    pthread_mutex_lock(&run->lock);
+    while (run->go == 0) {
+        pthread_cond_wait(&run->started, &run->lock);
+    }
+    int go = run->go;
+    pthread_mutex_unlock(&run->lock);
+    if (go < 0) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < conf->warmup_conf.runs; i++) {
+        conf->par_func(thread->id, run->threads);
+    }
+
+    pthread_barrier_wait(&run->barrier);
+    thread->start_ns = time_now_ns();
+
+    for (size_t i = 0; i < conf->runs_to_average; i++) {
+        BENCHMARK_CLOBBER_MEMORY();
+        uint64_t start = benchmark_timer_read(&run->runner->timer);
+        int s = conf->par_func(thread->id, run->threads);
+        BENCHMARK_DO_NOT_OPTIMIZE(s);
+        uint64_t end = benchmark_timer_read(&run->runner->timer);
+
+        uint64_t ns = benchmark_timer_ns(&run->runner->timer, start, end);
+        if (!histogram_record(&thread->hist, ns)) {
+            thread->failed = 1;
+            break;
+        }
+
+        // Each thread has its own part of the arrays so there is no need to lock
+        if (i < run->times_per_thread) {
+            entry->run_times_ns[thread->id * run->times_per_thread + i] = ns;
+        }
+        if (conf->monitor_func_output) {
+            entry->run_outputs[thread->id * conf->runs_to_average + i] = s;
+        }
+    }
+
+    thread->end_ns = time_now_ns();
+    return NULL;
+}
+
+/// Starts the threads for a FUNC_PARALLEL entry, then waits for them to finish
+static int start_scaling_threads(benchmark_scaling_run_t *run, benchmark_scaling_thread_t *threads)
+{
+    if (pthread_barrier_init(&run->barrier, NULL, run->threads) != 0) {
+        lprintf(LOG_ERROR, "Cannot init barrier\n");
+        return 0;
+    }
+    pthread_mutex_init(&run->lock, NULL);
+    pthread_cond_init(&run->started, NULL);
+    run->go = 0;
+
+    int ret = 1;
+    size_t started = 0;
+    for (; started < run->threads; started++) {
+        threads[started].id = started;
+        threads[started].run = run;
+        if (pthread_create(&threads[started].thread, NULL, &benchmark_scaling_thread, (void *) &threads[started]) != 0) {
+            lprintf(LOG_ERROR, "Cannot start benchmark thread\n");
+            ret = 0;
+            break;
+        }
+    }
+
+    // The barrier could never be released if a thread is missing, so the started threads are told
+    // to return before they reach it
+    if (started < run->threads) {
+        lprintf(LOG_ERROR, "Only %lu of %lu threads started\n", started, run->threads);
+    }
+    pthread_mutex_lock(&run->lock);
+    run->go = started < run->threads ? -1 : 1;
+    pthread_cond_broadcast(&run->started);
+    pthread_mutex_unlock(&run->lock);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i].thread, NULL);
+        ret &= !threads[i].failed;
+    }
+
+    pthread_cond_destroy(&run->started);
+    pthread_mutex_destroy(&run->lock);
+    pthread_barrier_destroy(&run->barrier);
+    return ret;
+}
+
+/// Runs a FUNC_PARALLEL entry with params[0] threads, params are owned by the profile
+static int run_benchmark_scaling_entry(benchmark_runner_t *runner, benchmark_profile_entry_t *entry, vector_t params)
+{
+    benchmark_conf_t *conf = runner->conf;
+    memset(entry, 0, sizeof(*entry));
+    entry->params = params;
+
+    if (params.values[0] < 1) {
+        lprintf(LOG_ERROR, "Cannot run a benchmark with %lf threads\n", params.values[0]);
+        return 0;
+    }
+
+    benchmark_scaling_run_t run;
+    run.runner = runner;
+    run.entry = entry;
+    run.threads = (size_t) round(params.values[0]);
+    run.times_per_thread = conf->runs_to_average;
+    if (conf->max_run_times > 0 && conf->max_run_times / run.threads < run.times_per_thread) {
+        run.times_per_thread = conf->max_run_times / run.threads;
+    }
+
+    entry->run_times_len = run.times_per_thread * run.threads;
+    entry->run_times_ns = malloc(sizeof(*entry->run_times_ns) * (entry->run_times_len > 0 ? entry->run_times_len : 1));
+    if (entry->run_times_ns == NULL) {
+        lprintf(LOG_ERROR, "Cannot allocate run times array\n");
+        return 0;
+    }
+
+    if (conf->monitor_func_output) {
+        entry->run_outputs_len = conf->runs_to_average * run.threads;
+        entry->run_outputs = malloc(sizeof(*entry->run_outputs) * (entry->run_outputs_len > 0 ? entry->run_outputs_len : 1));
+        if (entry->run_outputs == NULL) {
+            lprintf(LOG_ERROR, "Cannot allocate run outputs array\n");
+            return 0;
+        }
+    }
+
+    if (!init_cpu_core_usage(runner, entry)) {
+        return 0;
+    }
+
+    benchmark_scaling_thread_t *threads = calloc(run.threads, sizeof(*threads));
+    if (threads == NULL) {
+        lprintf(LOG_ERROR, "Cannot allocate benchmark threads\n");
+        return 0;
+    }
+
+    // The memory and, cpu profiles cover all of the threads for the whole entry, the cpu profiler
+    // allocates when it is calibrated so it goes first
+    if (conf->cpu_conf.enabled) {
+        calibrate_cpu_profiler(&runner->cpt);
+    }
+    if (conf->mem_conf.enabled) {
+        calibrate_memory_profiler(&runner->mtp);
+    }
+
+    int ret = start_scaling_threads(&run, threads);
+
+    if (conf->cpu_conf.enabled) {
+        add_cpu_core_usage(entry, &runner->cpt);
+    }
+    if (conf->mem_conf.enabled) {
+        add_memory_usage(entry, &runner->mtp);
+    }
+
+    histogram_t *hist = &runner->state.hist;
+    reset_histogram(hist);
+    uint64_t start = UINT64_MAX, end = 0;
+    for (size_t i = 0; i < run.threads; i++) {
+        ret &= histogram_merge(hist, &threads[i].hist);
+        free_histogram(&threads[i].hist);
+
+        start = threads[i].start_ns < start ? threads[i].start_ns : start;
+        end = threads[i].end_ns > end ? threads[i].end_ns : end;
+    }
+    free(threads);
+
+    entry->runs = hist->count;
+    entry->cpu_time_ns = hist->mean;
+    entry->cpu_time_us = entry->cpu_time_ns / 1000;
+    fill_benchmark_stats(&entry->time_stats, hist);
+
+    entry->scaling.threads = run.threads;
+    entry->scaling.wall_time_ns = end > start ? end - start : 0;
+    if (entry->scaling.wall_time_ns > 0) {
+        entry->scaling.throughput = (double) entry->runs * 1e9 / entry->scaling.wall_time_ns;
+    }
+
+    return ret;
+}
+
+/// Allocates the entries of a profile and, an arena for the params of each entry
+static int init_benchmark_entries(benchmark_profile_t *profile, size_t len, size_t dimensions)
+{
+    profile->entries = calloc(len > 0 ? len : 1, sizeof(*profile->entries));
+    if (profile->entries == NULL) {
         lprintf(LOG_ERROR, "Cannot malloc entries\n");
         return 0;
     }
 
-    memory_profiler_t mtp;
-    if (conf_bench->mem_conf.enabled) {
-        mtp.poll_time = conf_bench->mem_conf.poll_time;
-        init_memory_profiler(&mtp);
+    return init_param_arena(&profile->params_arena, len * dimensions);
+}
+
+/// The settings that change how the runs of an entry are done cannot be used by the threads of a
+/// FUNC_PARALLEL entry, they are rejected instead of being ignored
+static int check_scaling_conf(benchmark_conf_t *conf)
+{
+    benchmark_fixture_conf_t *fixture = &conf->fixture_conf;
+    int ret = 1;
+    if (conf->adaptive_conf.enabled) {
+        lprintf(LOG_ERROR, "Adaptive run counts cannot be used with FUNC_PARALLEL\n");
+        ret = 0;
+    }
+    if (conf->warmup_conf.until_steady) {
+        lprintf(LOG_ERROR, "Warming up until steady cannot be used with FUNC_PARALLEL\n");
+        ret = 0;
+    }
+    if (conf->cold_conf.enabled) {
+        lprintf(LOG_ERROR, "Cold runs cannot be used with FUNC_PARALLEL\n");
+        ret = 0;
+    }
+    if (fixture->func != NULL || fixture->setup != NULL || fixture->teardown != NULL
+            || fixture->run_setup != NULL || fixture->run_teardown != NULL) {
+        lprintf(LOG_ERROR, "Fixtures cannot be used with FUNC_PARALLEL\n");
+        ret = 0;
     }
+    return ret;
+}
 
-    // Run the benchmark runs
-    // Run function with no paramas if needed
-    if (conf_bench->function_type == FUNC_NO_PARAM) {
-        // Run the benchmark
-        struct timeval start;
-        gettimeofday(&start, NULL);
-        memset(output_profile->entries, 0, sizeof(*output_profile->entries));
-
-        if (conf_bench->monitor_func_output) {
-            output_profile->entries->run_outputs = malloc(sizeof(*output_profile->entries->run_outputs) * conf_bench->runs_to_average);
-            if (output_profile->entries->run_outputs == NULL) {
-                lprintf(LOG_ERROR, "Cannot allocate run outputs array\n");
-            }
+/// Runs a FUNC_PARALLEL benchmark for each of the thread counts in thread_conf
+static int benchmark_program_scaling(benchmark_runner_t *runner, benchmark_profile_t *output_profile)
+{
+    if (!check_scaling_conf(runner->conf)) {
+        return 0;
+    }
+
+    // A single dimensional range has the same start to end inclusive iteration as the params
+    multi_dimensional_range_t threads_range;
+    if (!init_multi_dimensional_range_arr(&threads_range, 1, &runner->conf->thread_conf.threads)) {
+        return 0;
+    }
+    multi_dimensional_range_start(&threads_range);
+
+    int ret = init_benchmark_entries(output_profile, multi_dimensional_range_len(&threads_range), 1);
+    while (ret) {
+        vector_t vect;
+        vect.dimensions = 1;
+        vect.values = param_arena_alloc(&output_profile->params_arena, 1);
+        if (vect.values == NULL || multi_dimensional_range_next_into(&threads_range, vect.values) != RANGE_GENERATING) {
+            break;
+        }
+
+        ret = run_benchmark_scaling_entry(runner, &output_profile->entries[output_profile->len++], vect);
+    }
+    free_multi_dimensional_range(&threads_range);
 
-            output_profile->entries->run_outputs_len = conf_bench->runs_to_average;
+    // Speedup and, efficiency are relative to the first thread count
+    if (output_profile->len > 0) {
+        benchmark_scaling_t base = output_profile->entries[0].scaling;
+        for (size_t i = 0; i < output_profile->len && base.throughput > 0; i++) {
+            benchmark_scaling_t *scaling = &output_profile->entries[i].scaling;
+            scaling->speedup = scaling->throughput / base.throughput;
+            scaling->efficiency = scaling->speedup * base.threads / scaling->threads;
         }
-        // The length for NO_PARAM is always 1
-        output_profile->len = 1;
+    }
 
-        for (size_t i = 0; i < conf_bench->runs_to_average; i++) {
-            // Reset profiler state
-            if (conf_bench->mem_conf.enabled) {
-                calibrate_memory_profiler(&mtp);
-            }
+    return ret;
+}
+
+/// Computes the params of every entry of the params generator up front
+static int generate_benchmark_entries(benchmark_conf_t *conf, benchmark_profile_t *profile)
+{
+    multi_dimensional_range_t *generator = &conf->param_conf.params_generator;
+    if (!init_benchmark_entries(profile, multi_dimensional_range_len(generator), generator->dimensions)) {
+        return 0;
+    }
+
+    multi_dimensional_range_start(generator);
+    while (1) {
+        vector_t vect;
+        vect.dimensions = generator->dimensions;
+        vect.values = param_arena_alloc(&profile->params_arena, vect.dimensions);
+        if (vect.values == NULL || multi_dimensional_range_next_into(generator, vect.values) != RANGE_GENERATING) {
+            return 1;
+        }
+
+        profile->entries[profile->len].params = vect;
+        profile->len++;
+    }
+}
+
+/// Does a block of runs of an entry, only the time in the block counts towards the time budget
+static int benchmark_entry_block(benchmark_runner_t *runner, benchmark_profile_entry_t *entry,
+                                 benchmark_entry_state_t *state, size_t block_runs)
+{
+    if (!setup_benchmark_fixture(runner->conf, entry->params)) {
+        return 0;
+    }
+    if (!state->started && !start_benchmark_entry(runner, entry, state)) {
+        teardown_benchmark_fixture(runner->conf, entry->params);
+        return 0;
+    }
+
+    int ret = 1;
+    state->start_ns = time_now_ns() - state->active_ns;
+    for (size_t i = 0; i < block_runs && ret; i++) {
+        if ((state->done = benchmark_entry_done(runner, entry, state))) {
+            break;
+        }
+        ret = benchmark_entry_run(runner, entry, state);
+    }
+    state->active_ns = time_now_ns() - state->start_ns;
+    teardown_benchmark_fixture(runner->conf, entry->params);
+
+    if (ret && !state->done) {
+        state->done = benchmark_entry_done(runner, entry, state);
+    }
+    return ret;
+}
+
+/// Runs a FUNC_PARAM sweep in rounds, each round does a block of runs of every entry that needs
+/// more runs. The totals of each entry are kept until the end of the sweep.
+static int benchmark_program_scheduled(benchmark_runner_t *runner, benchmark_profile_t *profile)
+{
+    benchmark_schedule_conf_t *schedule = &runner->conf->schedule_conf;
+    if (!generate_benchmark_entries(runner->conf, profile)) {
+        return 0;
+    }
+
+    size_t len = profile->len;
+    benchmark_entry_state_t *states = calloc(len > 0 ? len : 1, sizeof(*states));
+    size_t *order = malloc(sizeof(*order) * (len > 0 ? len : 1));
+    if (states == NULL || order == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc entry states\n");
+        free(states);
+        free(order);
+        return 0;
+    }
 
-            // Run the benchmark run
-            int s = conf_bench->np_func();
+    int ret = 1;
+    for (size_t i = 0; i < len; i++) {
+        init_histogram(&states[i].hist);
+        if (ret) {
+            ret = init_benchmark_entry(runner, &profile->entries[i], &states[i], profile->entries[i].params);
+        }
+    }
 
-            if (conf_bench->mem_conf.enabled) {
-                output_profile->entries->max_mem_usage += max_mem_usage(&mtp) / conf_bench->runs_to_average;
+    if (schedule->seed != 0) {
+        runner->rand_state = schedule->seed;
+    }
+    size_t block_runs = schedule->block_runs > 0 ? schedule->block_runs : 1;
+    size_t remaining = len;
+    while (ret && remaining > 0) {
+        size_t n = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (!states[i].done) {
+                order[n++] = i;
             }
+        }
 
-            if (conf_bench->monitor_func_output) {
-                output_profile->entries->run_outputs[i] = s;
+        if (schedule->order == SCHEDULE_SHUFFLED) {
+            for (size_t i = n - 1; i > 0; i--) {
+                size_t j = runner_rand(runner) % (i + 1);
+                size_t tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
             }
         }
 
-        struct timeval end;
-        gettimeofday(&end, NULL);
+        for (size_t i = 0; i < n && ret; i++) {
+            benchmark_entry_state_t *state = &states[order[i]];
+            ret = benchmark_entry_block(runner, &profile->entries[order[i]], state, block_runs);
+            remaining -= state->done;
+        }
+    }
 
-        long us_diff = time_diff(start, end) / conf_bench->runs_to_average;
-        output_profile->entries->cpu_time_us = us_diff;
+    for (size_t i = 0; i < len; i++) {
+        if (ret) {
+            finish_benchmark_entry(runner, &profile->entries[i], &states[i]);
+        }
+        free_histogram(&states[i].hist);
     }
-    // Run function with params otherwsie
-    else if (conf_bench->function_type == FUNC_PARAM) {
-        // Iterate over the param ranges as applicable
-        multi_dimensional_range_start(&conf_bench->param_conf.params_generator);
-        vector_t vect;
-        while (1) {
-            range_state_t state = multi_dimensional_range_next(&conf_bench->param_conf.params_generator, &vect);
-            if (state != RANGE_GENERATING) {
-                if (state == RANGE_ERROR) {
-                    lprintf(LOG_ERROR, "Cannot generate new range\n");
-                    return 0;
-                }
+    free(states);
+    free(order);
+    return ret;
+}
 
-                // RANGE_STOPPED has been reached meaning there are no more runs needed
+/// A thread that runs entries of a parallel sweep
+typedef struct benchmark_worker_t {
+    pthread_t thread;
+    /// The config without the profiles that cannot be used in parallel
+    benchmark_conf_t conf;
+    benchmark_runner_t runner;
+    benchmark_profile_t *profile;
+    /// The next entry to run, shared by all workers
+    atomic_size_t *next;
+    atomic_int *failed;
+    /// The cpu to pin to, -1 to not pin
+    int cpu;
+} benchmark_worker_t;
+
+static void *benchmark_worker_thread(void *worker_raw)
+{
+    benchmark_worker_t *worker = (benchmark_worker_t *) worker_raw;
+    if (worker->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            lprintf(LOG_WARNING, "Cannot pin worker to cpu %d\n", worker->cpu);
+        }
+    }
+
+    if (!init_benchmark_runner(&worker->runner, &worker->conf)) {
+        atomic_store(worker->failed, 1);
+        return NULL;
+    }
+
+    while (!atomic_load(worker->failed)) {
+        size_t i = atomic_fetch_add(worker->next, 1);
+        if (i >= worker->profile->len) {
+            break;
+        }
+
+        benchmark_profile_entry_t *entry = &worker->profile->entries[i];
+        if (!run_benchmark_entry(&worker->runner, entry, entry->params)) {
+            atomic_store(worker->failed, 1);
+        }
+    }
+
+    free_benchmark_runner(&worker->runner);
+    return NULL;
+}
+
+/// Marks a cpu and, its SMT siblings as used
+static void mark_cpu_siblings(int cpu, cpu_set_t *used)
+{
+    CPU_SET(cpu, used);
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return;
+    }
+
+    // The list looks like 0-1,8-9
+    int start, end;
+    while (fscanf(f, "%d", &start) == 1) {
+        end = start;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &end) != 1) {
                 break;
             }
+            c = fgetc(f);
+        }
 
-            struct timeval start;
-            gettimeofday(&start, NULL);
+        for (int i = start; i <= end && i < CPU_SETSIZE; i++) {
+            CPU_SET(i, used);
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(f);
+}
 
-            // Realloc the entries array
-            size_t ptr = output_profile->len;
-            output_profile->entries = realloc(output_profile->entries, sizeof(*output_profile->entries) * (ptr + 1));
-            if (output_profile->entries == NULL) {
-                lprintf(LOG_ERROR, "Cannot realloc entries\n");
-                return 0;
+/// Picks the cpus that workers are pinned to, returns the amount of cpus that were found
+static size_t pick_worker_cpus(benchmark_parallel_conf_t *parallel, int *cpus, size_t max, int isolate)
+{
+    cpu_set_t allowed, used;
+    CPU_ZERO(&used);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        lprintf(LOG_ERROR, "Cannot get the cpus that this process can use\n");
+        return 0;
+    }
+
+    size_t len = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && len < max; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || CPU_ISSET(cpu, &used)) {
+            continue;
+        }
+
+        if (isolate) {
+            if (cpu == 0) {
+                // Leave cpu 0 (and its siblings) for the kernel and, the calling thread
+                mark_cpu_siblings(cpu, &used);
+                continue;
             }
+            mark_cpu_siblings(cpu, &used);
+        }
+        cpus[len++] = cpu;
+    }
 
-            memset(&output_profile->entries[ptr], 0, sizeof(output_profile->entries[output_profile->len]));
+    if (len == 0 && isolate) {
+        lprintf(LOG_WARNING, "There are no cpus left after isolation, not isolating workers\n");
+        return pick_worker_cpus(parallel, cpus, max, 0);
+    }
+    return len;
+}
+
+/// Runs the entries of a FUNC_PARAM benchmark on a pool of worker threads, each entry is
+/// run by one worker so the output is the same order as a serial sweep
+static int benchmark_program_parallel(benchmark_conf_t *conf_bench, benchmark_profile_t *output_profile)
+{
+    if (!generate_benchmark_entries(conf_bench, output_profile)) {
+        return 0;
+    }
 
-            if (conf_bench->monitor_func_output) {
-                output_profile->entries[ptr].run_outputs = malloc(sizeof(*output_profile->entries[ptr].run_outputs) * conf_bench->runs_to_average);
-                if (output_profile->entries[ptr].run_outputs == NULL) {
-                    lprintf(LOG_ERROR, "Cannot allocate run outputs array\n");
-                }
+    benchmark_parallel_conf_t *parallel = &conf_bench->parallel_conf;
+    size_t threads = parallel->threads < output_profile->len ? parallel->threads : output_profile->len;
+    if (threads == 0) {
+        return 1;
+    }
 
-                output_profile->entries[ptr].run_outputs_len = conf_bench->runs_to_average;
-            }
+    if (conf_bench->schedule_conf.order != SCHEDULE_SEQUENTIAL) {
+        lprintf(LOG_WARNING, "The run order is not used for parallel sweeps\n");
+    }
+
+    benchmark_conf_t worker_conf = *conf_bench;
+    if (worker_conf.mem_conf.enabled || worker_conf.cpu_conf.enabled || worker_conf.cold_conf.enabled
+            || worker_conf.alloc_conf.enabled) {
+        lprintf(LOG_WARNING, "Memory, cpu, allocation and, cold profiles are disabled for parallel sweeps\n");
+        worker_conf.alloc_conf.enabled = 0;
+        worker_conf.mem_conf.enabled = 0;
+        worker_conf.cpu_conf.enabled = 0;
+        worker_conf.cold_conf.enabled = 0;
+    }
 
-            // Start profilers
-            for (size_t i = 0; i < conf_bench->runs_to_average; i++) {
-                // Reset profilers state
-                if (conf_bench->mem_conf.enabled) {
-                    calibrate_memory_profiler(&mtp);
-                }
+    int cpus[threads];
+    size_t cpus_len = 0;
+    if (parallel->pin) {
+        cpus_len = pick_worker_cpus(parallel, cpus, threads, parallel->isolate);
+        if (cpus_len < threads) {
+            lprintf(LOG_WARNING, "There are %lu workers but only %lu cpus to pin them to\n", threads, cpus_len);
+        }
+    }
 
-                // Run the benchmark run
-                int s = conf_bench->p_func(vect);
+    benchmark_worker_t *workers = malloc(sizeof(*workers) * threads);
+    if (workers == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc workers\n");
+        return 0;
+    }
 
-                if (conf_bench->mem_conf.enabled) {
-                    output_profile->entries[ptr].max_mem_usage += max_mem_usage(&mtp) / conf_bench->runs_to_average;
-                }
+    atomic_size_t next = 0;
+    atomic_int failed = 0;
+    size_t started = 0;
+    for (; started < threads; started++) {
+        benchmark_worker_t *worker = &workers[started];
+        worker->conf = worker_conf;
+        worker->profile = output_profile;
+        worker->next = &next;
+        worker->failed = &failed;
+        worker->cpu = cpus_len > 0 ? cpus[started % cpus_len] : -1;
 
-                // If recording output state realloc the run_outputs
-                if (conf_bench->monitor_func_output) {
-                    output_profile->entries[ptr].run_outputs[i] = s;
-                }
-            }
+        if (pthread_create(&worker->thread, NULL, &benchmark_worker_thread, (void *) worker) != 0) {
+            lprintf(LOG_ERROR, "Cannot start worker thread\n");
+            atomic_store(&failed, 1);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    free(workers);
+
+    return !atomic_load(&failed);
+}
+
+/// Whether the entries are run by run_isolated_entry, see benchmark_isolation_conf_t
+static int benchmark_isolated(benchmark_conf_t *conf)
+{
+    return conf->isolation_conf.enabled
+           && (conf->function_type == FUNC_NO_PARAM
+               || (conf->function_type == FUNC_PARAM && conf->parallel_conf.threads <= 1
+                   && conf->schedule_conf.order == SCHEDULE_SEQUENTIAL));
+}
+
+/// Runs the entries of a benchmark on the calling thread, serial FUNC_PARAM sweeps write each entry
+/// to sink as soon as it is finished when sink is not NULL. If ckpt is not NULL the sweep starts at
+/// ckpt->next_index and, the checkpoint is updated after each entry.
+static int benchmark_program_serial(benchmark_conf_t *conf_bench, benchmark_profile_t *output_profile,
+                                    benchmark_sink_t *sink, benchmark_checkpoint_t *ckpt)
+{
+    // Isolated entries start their own runner in their process
+    int isolated = benchmark_isolated(conf_bench);
+    benchmark_runner_t runner;
+    if (!isolated && !init_benchmark_runner(&runner, conf_bench)) {
+        return 0;
+    }
+
+    int ret = 1;
+    // Run the benchmark runs
+    // Run function with no paramas if needed
+    if (conf_bench->function_type == FUNC_NO_PARAM) {
+        vector_t no_params;
+        memset(&no_params, 0, sizeof(no_params));
 
-            struct timeval end;
-            gettimeofday(&end, NULL);
+        // The length for NO_PARAM is always 1
+        ret = init_benchmark_entries(output_profile, 1, 0);
+        if (ret) {
+            output_profile->len = 1;
+            ret = isolated ? run_isolated_entry(conf_bench, output_profile->entries, no_params)
+                  : run_benchmark_entry(&runner, output_profile->entries, no_params);
+        }
+    }
+    // Run function with params otherwsie
+    else if (conf_bench->function_type == FUNC_PARAM && conf_bench->schedule_conf.order != SCHEDULE_SEQUENTIAL) {
+        ret = benchmark_program_scheduled(&runner, output_profile);
+    } else if (conf_bench->function_type == FUNC_PARAM) {
+        // When entries are discarded once streamed a single entry and, vector are reused
+        int discard = sink != NULL && conf_bench->stream_conf.discard_entries;
 
-            // Get average time
-            long us_diff = time_diff(start, end) / conf_bench->runs_to_average;
-            output_profile->entries[ptr].cpu_time_us = us_diff;
-            output_profile->entries[ptr].params = vect;
+        // Iterate over the param ranges as applicable, the vectors are put in the arena so that
+        // the sweep does a single allocation for all of them
+        multi_dimensional_range_t *generator = &conf_bench->param_conf.params_generator;
+        size_t len = multi_dimensional_range_len(generator);
+        size_t first = ckpt == NULL ? 0 : ckpt->next_index < len ? ckpt->next_index : len;
+        ret = init_benchmark_entries(output_profile, discard ? 1 : len - first, generator->dimensions);
+        multi_dimensional_range_start(generator);
+        generator->index = first;
+        while (ret) {
+            vector_t vect;
+            vect.dimensions = generator->dimensions;
+            vect.values = param_arena_alloc(&output_profile->params_arena, vect.dimensions);
+            if (vect.values == NULL || multi_dimensional_range_next_into(generator, vect.values) != RANGE_GENERATING) {
+                // RANGE_STOPPED has been reached meaning there are no more runs needed
+                break;
+            }
 
-            // Continue the iteration
-            output_profile->len++;
+            benchmark_profile_entry_t *entry = &output_profile->entries[discard ? 0 : output_profile->len++];
+            ret = isolated ? run_isolated_entry(conf_bench, entry, vect) : run_benchmark_entry(&runner, entry, vect);
+            if (ret && sink != NULL) {
+                ret = write_benchmark_sink(sink, entry);
+            }
+            if (ret && ckpt != NULL) {
+                ckpt->next_index = generator->index;
+                ckpt->entries = sink->entries;
+                ckpt->output_offset = ftell(sink->f);
+                ret = write_benchmark_checkpoint(conf_bench->stream_conf.output, ckpt);
+            }
+            if (discard) {
+                free_benchmark_entry(entry);
+                output_profile->params_arena.used = 0;
+            }
         }
+    } else if (conf_bench->function_type == FUNC_PARALLEL) {
+        ret = benchmark_program_scaling(&runner, output_profile);
     } else {
         lprintf(LOG_ERROR, "Invalid function type\n");
+        ret = 0;
     }
 
-    if (conf_bench->mem_conf.enabled) {
-        free_memory_profiler(&mtp);
+    if (!isolated) {
+        free_benchmark_runner(&runner);
     }
+    return ret;
+}
 
-    return 1;
+int benchmark_program(benchmark_conf_t *conf_bench, benchmark_profile_t *output_profile)
+{
+    // Init output, this is done first so that the profile can always be freed
+    output_profile->conf = *conf_bench;
+    output_profile->len = 0;
+    output_profile->entries = NULL;
+    init_param_arena(&output_profile->params_arena, 0);
+
+    if (conf_bench->adaptive_conf.enabled && conf_bench->adaptive_conf.target_rel_ci < 0) {
+        lprintf(LOG_ERROR, "adaptive_conf.target_rel_ci cannot be negative\n");
+        return 0;
+    }
+
+    capture_benchmark_env(&output_profile->env);
+    if (conf_bench->preflight_conf.enabled && !benchmark_preflight(&output_profile->env, &conf_bench->preflight_conf)) {
+        return 0;
+    }
+
+    benchmark_stream_conf_t *stream = &conf_bench->stream_conf;
+    int parallel = conf_bench->function_type == FUNC_PARAM && conf_bench->parallel_conf.threads > 1;
+
+    // Checkpoints need the entries to be written in order as they finish
+    benchmark_checkpoint_t ckpt, *ckpt_ptr = NULL;
+    int resume = 0;
+    if (stream->output != NULL && stream->checkpoint) {
+        if (conf_bench->function_type != FUNC_PARAM || parallel
+                || conf_bench->schedule_conf.order != SCHEDULE_SEQUENTIAL) {
+            lprintf(LOG_WARNING, "Checkpoints are only used for serial, sequential FUNC_PARAM sweeps\n");
+        } else {
+            ckpt_ptr = &ckpt;
+            uint64_t fingerprint = benchmark_conf_fingerprint(conf_bench);
+            resume = read_benchmark_checkpoint(stream->output, &ckpt) && ckpt.fingerprint == fingerprint;
+            if (resume) {
+                lprintf(LOG_INFO, "Resuming from entry %lu\n", ckpt.next_index);
+            } else {
+                memset(&ckpt, 0, sizeof(ckpt));
+                ckpt.fingerprint = fingerprint;
+            }
+        }
+    }
+
+    if (conf_bench->isolation_conf.enabled && !benchmark_isolated(conf_bench)) {
+        lprintf(LOG_WARNING, "Isolation is only used for FUNC_NO_PARAM and, serial, sequential FUNC_PARAM sweeps\n");
+    }
+
+    benchmark_sink_t sink;
+    if (stream->output != NULL) {
+        if (!open_benchmark_sink(&sink, stream->output, resume ? &ckpt : NULL)) {
+            return 0;
+        }
+        sink.env = &output_profile->env;
+    }
+
+    int ret;
+    if (parallel) {
+        ret = benchmark_program_parallel(conf_bench, output_profile);
+    } else {
+        ret = benchmark_program_serial(conf_bench, output_profile, stream->output != NULL ? &sink : NULL, ckpt_ptr);
+    }
+
+    // A finished sweep starts from the beginning next time
+    if (ret && ckpt_ptr != NULL) {
+        remove_benchmark_checkpoint(stream->output);
+    }
+
+    if (stream->output == NULL) {
+        return ret;
+    }
+
+    // Entries that could not be streamed as they finished are written now, sink.entries cannot be
+    // used as it counts the entries from a checkpoint that are not in this profile
+    for (size_t i = sink.streamed; i < output_profile->len && ret; i++) {
+        ret = write_benchmark_sink(&sink, &output_profile->entries[i]);
+    }
+    close_benchmark_sink(&sink);
+
+    if (stream->discard_entries) {
+        for (size_t i = 0; i < output_profile->len; i++) {
+            free_benchmark_entry(&output_profile->entries[i]);
+        }
+        output_profile->len = 0;
+    }
+    return ret;
 }
 
 int save_benchmark(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf)
@@ -197,6 +1905,10 @@ int save_benchmark(benchmark_profile_t *profile, benchmark_output_conf_t *output
         return save_benchmark_json(profile, output_conf);
     case OUTPUT_CSV:
         return save_benchmark_csv(profile, output_conf);
+    case OUTPUT_NDJSON:
+        return save_benchmark_ndjson(profile, output_conf);
+    case OUTPUT_BINARY:
+        return save_benchmark_binary(profile, output_conf);
     }
 
     lprintf(LOG_ERROR, "Cannot find output type\n");
@@ -208,12 +1920,9 @@ void free_benchmark_profile(benchmark_profile_t *profile)
     if (profile == NULL) return;
     if (profile->entries != NULL) {
         for (size_t i = 0; i < profile->len; i++) {
-            if (profile->entries[i].run_outputs != NULL) {
-                free(profile->entries[i].run_outputs);
-            }
-
-            free_vector(&profile->entries[i].params);
+            free_benchmark_entry(&profile->entries[i]);
         }
         free(profile->entries);
     }
+    free_param_arena(&profile->params_arena);
 }
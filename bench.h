@@ -1,5 +1,11 @@
 #pragma once
 #include "./ranges.h"
+#include "./time_utils.h"
+#include "./perf_profiler.h"
+#include "./alloc_tracker.h"
+#include "./bench_barrier.h"
+#include "./bench_env.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +17,13 @@ typedef struct benchmark_mem_conf_t {
     int enabled;
     /// ms, recommended is about 1
     long poll_time;
+    /// Whether to poll the resident set size as well as the heap
+    int rss;
+    /// Whether to poll the proportional set size as well as the heap, this is slow to read
+    int pss;
+    /// Whether to not poll the heap, max_mem_usage is then 0. Polling the heap (mallinfo2) takes the
+    /// lock of every malloc arena, which can stall the allocations of the benchmarked function
+    int skip_heap;
 } benchmark_mem_conf_t;
 
 /// The default config for memory profiling
@@ -28,23 +41,228 @@ typedef struct benchmark_cpu_conf_t {
 /// The default config for cpu core profiling
 #define DEFAULT_BENCHMARK_CPU_CONF {1, 2500}
 
+/// Adaptive run count settings, when this is enabled runs_to_average is ignored and,
+/// each entry is run until the 95% confidence interval of the mean is narrow enough
+typedef struct benchmark_adaptive_conf_t {
+    /// Whether to use an adaptive run count
+    int enabled;
+    /// The width of the confidence interval relative to the mean to stop at, i.e: 0.02 for +-1%,
+    /// 0 to never stop early
+    double target_rel_ci;
+    /// The least runs to do, even if the interval is narrow enough
+    size_t min_runs;
+    /// The most runs to do, even if the interval is not narrow enough
+    size_t max_runs;
+    /// ms that each entry can run for before it is stopped, 0 for no limit
+    long time_budget;
+} benchmark_adaptive_conf_t;
+
+/// The default config for adaptive run counts
+#define DEFAULT_BENCHMARK_ADAPTIVE_CONF {1, 0.02, 10, 100000, 10000}
+
+/// Hardware performance counter settings, the counters are for the thread that calls the
+/// function so they are not used for FUNC_PARALLEL
+typedef struct benchmark_perf_conf_t {
+    /// Whether to read the perf counters for each run
+    int enabled;
+} benchmark_perf_conf_t;
+
+/// Allocation tracking settings, every malloc, realloc and, free of the process is counted
+/// during the timed call. This needs the library to be built with -DBENCHMARK_MALLOC_HOOKS=ON and,
+/// adds a few atomic operations to each allocation, which are in the run times. Allocations are
+/// not tracked for FUNC_PARALLEL as the threads allocate their own state.
+typedef struct benchmark_alloc_conf_t {
+    /// Whether to count the allocations of each run
+    int enabled;
+} benchmark_alloc_conf_t;
+
+/// Warm up settings, warm up runs are done before the measured runs of each entry
+/// so that page faults, cold caches and, lazy binding are not in the results
+typedef struct benchmark_warmup_conf_t {
+    /// The number of warm up runs to do, these are not recorded
+    size_t runs;
+    /// Whether to keep warming up until the run time is steady (after runs)
+    int until_steady;
+    /// The relative change between the means of two windows of runs that is steady, i.e: 0.05
+    double steady_threshold;
+    /// The most warm up runs to do when waiting for the run time to be steady
+    size_t max_runs;
+} benchmark_warmup_conf_t;
+
+/// The default config for warm up, wait for the run time to change by less than 5%
+#define DEFAULT_BENCHMARK_WARMUP_CONF {0, 1, 0.05, 1000}
+
+/// Cold run settings, cold runs have the caches flushed before them to measure the first
+/// call to a function. They are done before the warm up and, are reported separately.
+typedef struct benchmark_cold_conf_t {
+    /// Whether to do cold runs
+    int enabled;
+    /// The number of cold runs to do
+    size_t runs;
+    /// Bytes of memory to stream through to flush the caches, 0 for twice the size of the LLC
+    size_t flush_size;
+} benchmark_cold_conf_t;
+
+/// Parallel sweep settings, the entries of a FUNC_PARAM benchmark are shared between worker
+/// threads that are each pinned to a cpu. The memory, cpu and, cold profiles measure the whole
+/// machine so they are disabled when the sweep is parallel.
+typedef struct benchmark_parallel_conf_t {
+    /// Worker threads to use, 0 or 1 runs the sweep on the calling thread
+    size_t threads;
+    /// Whether to pin each worker to a cpu
+    int pin;
+    /// Whether to leave cpu 0 and, the SMT siblings of each worker's cpu idle
+    int isolate;
+} benchmark_parallel_conf_t;
+
+/// The order that the runs of the entries of a FUNC_PARAM sweep are done in
+typedef enum benchmark_schedule_t {
+    /// All of the runs of an entry are done before the next entry
+    SCHEDULE_SEQUENTIAL = 0,
+    /// A block of runs of each entry is done in turn, in the order of the entries
+    SCHEDULE_INTERLEAVED,
+    /// A block of runs of each entry is done in turn, in a new random order each round
+    SCHEDULE_SHUFFLED
+} benchmark_schedule_t;
+
+/// Run ordering settings for FUNC_PARAM sweeps. Spreading the runs of each entry over the whole
+/// sweep stops drift over time (i.e: the cpu heating up) from looking like a trend in the params.
+/// The cold and, warm up runs of an entry are done just before its first block.
+typedef struct benchmark_schedule_conf_t {
+    benchmark_schedule_t order;
+    /// Runs of an entry that are done back to back, 0 is the same as 1
+    size_t block_runs;
+    /// Seed for SCHEDULE_SHUFFLED, 0 uses a fixed seed
+    uint64_t seed;
+} benchmark_schedule_conf_t;
+
 typedef enum benchmark_func_type_t {
     FUNC_PARAM,
-    FUNC_NO_PARAM
+    FUNC_NO_PARAM,
+    /// The function is called by many threads at once, see benchmark_thread_conf_t
+    FUNC_PARALLEL
 } benchmark_func_type_t;
 
+/// Thread scaling settings for FUNC_PARALLEL. For each thread count the threads are released
+/// by a barrier and, each calls the function runs_to_average times. Adaptive run counts, warming up
+/// until steady, cold runs and, fixtures cannot be used with this.
+typedef struct benchmark_thread_conf_t {
+    /// The thread counts to sweep over, i.e: 1 -> 8; 1
+    range_t threads;
+} benchmark_thread_conf_t;
+
 /// Configuration for parameters for the function that is called
 /// this allows for exciting data to be generated.
 typedef struct benchmark_param_conf_t {
     multi_dimensional_range_t params_generator;
 } benchmark_param_conf_t;
 
+/// Different ways for the output to be saved
+typedef enum benchmark_output_type_t {
+    /// A single json file
+    OUTPUT_JSON,
+    /// Many CSV files
+    OUTPUT_CSV,
+    /// A json object for each entry, one per line
+    OUTPUT_NDJSON,
+    /// A fixed width columnar file that can be read with a mmap, see bench_binary.h
+    OUTPUT_BINARY
+} benchmark_output_type_t;
+
+/// This struct is the output configuration for benchmarks
+typedef struct benchmark_output_conf_t {
+    /// This is the prefix for the file that the output is saved as
+    char *output_file_prefix;
+    /// The type of output (i.e: JSON or, CSV)
+    benchmark_output_type_t output_type;
+} benchmark_output_conf_t;
+
+/// Streaming output settings, each entry is appended to the output file and, flushed when it is
+/// finished so that partial results can be read during a sweep and, are kept after a crash.
+/// Serial FUNC_PARAM sweeps stream each entry as it finishes, the other types stream at the end.
+typedef struct benchmark_stream_conf_t {
+    /// The OUTPUT_CSV or, OUTPUT_NDJSON output to stream to, NULL to not stream
+    benchmark_output_conf_t *output;
+    /// Whether to free each entry once it is written, the profile then has no entries
+    int discard_entries;
+    /// Whether to write a checkpoint (<prefix>.bench.<csv|ndjson>.ckpt) after each entry of a serial,
+    /// sequential FUNC_PARAM sweep. A re-run with the same config and, output skips the points that are in the
+    /// output already, those entries are not in the profile. The checkpoint is removed at the end.
+    int checkpoint;
+} benchmark_stream_conf_t;
+
+/// Callbacks that run outside of the timed region and, outside of the profiles of each run, so that
+/// input data is not measured. Each is passed ctx and, the params of the entry (empty for
+/// FUNC_NO_PARAM). FUNC_PARALLEL benchmarks fail if any are set, parallel sweeps call them from each
+/// worker with the same ctx so they have to be thread safe then.
+typedef struct benchmark_fixture_conf_t {
+    /// Owned by the caller
+    void *ctx;
+    /// If set this is benchmarked instead of np_func or, p_func
+    int (*func)(void *ctx, vector_t params);
+    /// Called before the runs of an entry (cold and, warm up runs included), 0 on failure. Interleaved
+    /// and, shuffled sweeps call this before each block of runs
+    int (*setup)(void *ctx, vector_t params);
+    /// Called after the runs that setup was called for
+    void (*teardown)(void *ctx, vector_t params);
+    /// Called before each run, 0 on failure
+    int (*run_setup)(void *ctx, vector_t params);
+    /// Called after each run
+    void (*run_teardown)(void *ctx, vector_t params);
+} benchmark_fixture_conf_t;
+
+/// Calls a function that does many iterations of the operation that is being benchmarked in each run,
+/// for operations that are too quick to time one at a time. The time of a call with 0 iterations is
+/// taken off each run. The run times and, time_stats are of the whole batch as an iteration can take
+/// less than a ns, divide them by batch_iterations for the time of an iteration. op_time_ns is
+/// already per iteration. Not used for FUNC_PARALLEL.
+typedef struct benchmark_batch_conf_t {
+    int enabled;
+    /// Called instead of np_func or, p_func with the ctx of benchmark_fixture_conf_t
+    int (*func)(void *ctx, vector_t params, size_t iterations);
+    /// How long a run should take in ns, the iterations are found for each entry to meet this.
+    /// Defaults to 10us
+    size_t target_ns;
+    /// The iterations of each run, 0 to find them from target_ns
+    size_t iterations;
+} benchmark_batch_conf_t;
+
+/// How much each operation (a run or, a batch iteration) processes, for the throughput of an entry.
+/// The amounts are found from the params once per entry when the functions are set, otherwise they
+/// are what the benchmarked function reports with benchmark_report_bytes and, benchmark_report_items.
+/// Not used for FUNC_PARALLEL.
+typedef struct benchmark_throughput_conf_t {
+    /// The bytes of an operation with some params, can be NULL
+    double (*bytes)(vector_t params);
+    /// The items (i.e: records, tokens or, messages) of an operation with some params, can be NULL
+    double (*items)(vector_t params);
+} benchmark_throughput_conf_t;
+
+/// Runs each entry in a child process that is forked for it. A crash or, a hang then only loses that
+/// entry and, each entry starts with a fresh heap. Used for FUNC_NO_PARAM and, serial, sequential
+/// FUNC_PARAM sweeps, the runs of an entry are all done in its child.
+typedef struct benchmark_isolation_conf_t {
+    int enabled;
+    /// The longest an entry can take in ms before its process is killed, 0 for no limit
+    size_t timeout_ms;
+    /// The address space limit (RLIMIT_AS) of the child in bytes, 0 for no limit
+    size_t max_memory;
+    /// The cpu time limit (RLIMIT_CPU) of the child in seconds, 0 for no limit
+    size_t max_cpu_s;
+} benchmark_isolation_conf_t;
+
 /// Configuration for the benchmark
 typedef struct benchmark_conf_t {
     /// Number of runs of the benchmark to do to get an average
     size_t runs_to_average;
+    /// If enabled this is used instead of runs_to_average
+    benchmark_adaptive_conf_t adaptive_conf;
+    benchmark_warmup_conf_t warmup_conf;
+    benchmark_cold_conf_t cold_conf;
     benchmark_cpu_conf_t cpu_conf;
     benchmark_mem_conf_t mem_conf;
+    benchmark_perf_conf_t perf_conf;
+    benchmark_alloc_conf_t alloc_conf;
 
     /// If this is set to FUNC_PARAM then param_conf must be set
     benchmark_func_type_t function_type;
@@ -54,31 +272,41 @@ typedef struct benchmark_conf_t {
         /// if function type is FUNC_PARAM, set this to the func to benchmark
         /// and set param_conf.
         int (*p_func)(vector_t params);
+        /// if function type is FUNC_PARALLEL, set this to the func to benchmark
+        /// and set thread_conf. thread is 0 to threads - 1
+        int (*par_func)(size_t thread, size_t threads);
     };
 
+    benchmark_fixture_conf_t fixture_conf;
+    benchmark_batch_conf_t batch_conf;
+    benchmark_throughput_conf_t throughput_conf;
+
     /// If FUNC_PARAM this must be set to the generator for the parameters send to p_func
     benchmark_param_conf_t param_conf;
+    /// If FUNC_PARALLEL this must be set to the thread counts to use
+    benchmark_thread_conf_t thread_conf;
+
+    /// If FUNC_PARAM this can be set to run the entries in parallel, output is still in the
+    /// order of the generator
+    benchmark_parallel_conf_t parallel_conf;
+    /// The order of the runs of a FUNC_PARAM sweep, this is not used for parallel sweeps
+    benchmark_schedule_conf_t schedule_conf;
+    benchmark_stream_conf_t stream_conf;
+    benchmark_isolation_conf_t isolation_conf;
+    /// Checks the environment before any runs, see benchmark_preflight
+    benchmark_preflight_conf_t preflight_conf;
 
     /// Function output is 0 for failure, toggling this will save output,
     /// allowing for functions to provide data for plotting if you want that
     int monitor_func_output;
-} benchmark_conf_t;
 
-/// Different ways for the output to be saved
-typedef enum benchmark_output_type_t {
-    /// A single json file
-    OUTPUT_JSON,
-    /// Many CSV files
-    OUTPUT_CSV
-} benchmark_output_type_t;
+    /// The clock that each run is timed with, defaults to TIMER_MONOTONIC
+    benchmark_timer_type_t timer;
 
-/// This struct is the output configuration for benchmarks
-typedef struct benchmark_output_conf_t {
-    /// This is the prefix for the file that the output is saved as
-    char *output_file_prefix;
-    /// The type of output (i.e: JSON or, CSV)
-    benchmark_output_type_t output_type;
-} benchmark_output_conf_t;
+    /// The most run times to keep in run_times_ns, 0 keeps all of them. When there are more
+    /// runs than this a uniform sample of them is kept, the statistics still use every run.
+    size_t max_run_times;
+} benchmark_conf_t;
 
 /// Inits the config, a NULL name will make a default prefix be used (recommended?)
 int init_benchmark_output_conf(benchmark_output_conf_t *conf, benchmark_output_type_t t, char *name);
@@ -87,18 +315,137 @@ int init_benchmark_output_conf(benchmark_output_conf_t *conf, benchmark_output_t
 /// This does not free any ranges that are in the conf. these are "owned" by the caller
 void free_benchmark_output_conf(benchmark_output_conf_t *conf);
 
+/// Statistics of the time of each run of an entry in ns, these are read from a
+/// histogram so percentiles are within 1% of the exact value
+typedef struct benchmark_stats_t {
+    uint64_t min;
+    uint64_t max;
+    double mean;
+    double stddev;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    /// Median absolute deviation
+    uint64_t mad;
+} benchmark_stats_t;
+
+/// Thread scaling results for FUNC_PARALLEL entries, speedup is relative to the first entry
+typedef struct benchmark_scaling_t {
+    /// The number of threads that called the function
+    size_t threads;
+    /// The time from the barrier being released to the last thread finishing
+    uint64_t wall_time_ns;
+    /// Calls of the function per second across all threads
+    double throughput;
+    /// throughput / the throughput of the first entry
+    double speedup;
+    /// speedup / the increase in threads from the first entry, 1 is perfect scaling
+    double efficiency;
+} benchmark_scaling_t;
+
+/// Whether an entry finished, only isolated entries (benchmark_isolation_conf_t) can fail without
+/// stopping the benchmark
+typedef enum benchmark_entry_status_t {
+    ENTRY_OK,
+    /// The process of the entry was killed by a signal, see benchmark_profile_entry_t::signal
+    ENTRY_CRASHED,
+    /// The process of the entry took longer than benchmark_isolation_conf_t::timeout_ms
+    ENTRY_TIMED_OUT,
+    /// The process of the entry exited with an error, i.e: a profiler could not be started
+    ENTRY_FAILED
+} benchmark_entry_status_t;
+
+/// The name of a status as it is in the outputs
+const char *benchmark_entry_status_name(benchmark_entry_status_t status);
+
+/// The average of each perf counter per run that it was counted in
+typedef struct benchmark_perf_t {
+    /// Bit i is set if perf_counter_t i was counted in any run, unavailable counters are 0
+    uint32_t available;
+    /// Indexed by perf_counter_t
+    double counters[PERF_COUNTERS];
+    /// Instructions per cycle, 0 if either is not available
+    double ipc;
+} benchmark_perf_t;
+
+/// The allocations of the runs of an entry, the counts are the average per run
+typedef struct benchmark_alloc_t {
+    /// The most bytes that were live at once in any run, relative to the start of the run
+    size_t peak_bytes;
+    double total_bytes;
+    double allocations;
+    double frees;
+    /// See alloc_stats_t::size_classes
+    double size_classes[ALLOC_SIZE_CLASSES];
+} benchmark_alloc_t;
+
 /// A profile will contain many entries, this will store data for a function with certain parameters
 /// This is an average for the runs (as specified in the config), everything that is continuous is
 /// averaged, run_outputs are not.
 typedef struct benchmark_profile_entry_t {
-    /// Has length 0 is there are no parameters for the entry.
+    /// Has length 0 is there are no parameters for the entry. The values are owned by
+    /// benchmark_profile_t::params_arena so do not free them.
     vector_t params;
+    /// The number of runs that were done
+    size_t runs;
+    /// Whether an adaptive run count reached its target confidence interval
+    int converged;
+    /// Anything other than ENTRY_OK has no results other than the params
+    benchmark_entry_status_t status;
+    /// The signal that killed the process of an ENTRY_CRASHED entry
+    int signal;
     /// A measure of how much time the benchmark took to complete
     size_t cpu_time_us;
-    /// Set to MAX_LONG_INT if this profile is disabled (benchmark_cpu_conf_t)
+    /// The mean time of a run in ns
+    size_t cpu_time_ns;
+    /// The mean time of an operation in ns, for batches this is per iteration without the overhead
+    double op_time_ns;
+    /// The iterations of each run and, the time of a call with no iterations that was taken off each
+    /// run, only set when benchmark_batch_conf_t is enabled
+    size_t batch_iterations;
+    double batch_overhead_ns;
+    /// The mean bytes and, items of an operation, 0 if they are not known. See
+    /// benchmark_throughput_conf_t
+    double bytes_per_op;
+    double items_per_op;
+    /// Rates from op_time_ns, 0 when the bytes or, items are not known. A GB is 10^9 bytes
+    double gb_per_s;
+    double items_per_s;
+    double ns_per_item;
+    /// Statistics of the run times
+    benchmark_stats_t time_stats;
+    /// The number of warm up runs that were done before the measured runs
+    size_t warmup_runs;
+    /// The number of cold runs that were done
+    size_t cold_runs;
+    /// Statistics of the cold run times, these are separate to time_stats
+    benchmark_stats_t cold_time_stats;
+    /// Set if benchmark_perf_conf_t is enabled
+    benchmark_perf_t perf;
+    /// Set if benchmark_alloc_conf_t is enabled
+    benchmark_alloc_t allocs;
+    /// Only set for FUNC_PARALLEL, time_stats are then the latency of each call on each thread
+    benchmark_scaling_t scaling;
+    /// The length of run_times_ns
+    size_t run_times_len;
+    /// The time that each run took in ns, see benchmark_conf_t::max_run_times
+    uint64_t *run_times_ns;
+    /// The cpu time per run, only the timed part of each run is measured so the fixtures are not
+    /// included. Set to MAX_LONG_INT if this profile is disabled (benchmark_cpu_conf_t)
     size_t cpu_core_time_us;
+    /// The number of cores in cpu_core_usage_us, 0 if the cpu profile is disabled
+    size_t cpu_cores;
+    /// The busy time of each core in the system per run (not just this process)
+    size_t *cpu_core_usage_us;
     /// Set to MAX_LONG_INT if this profile is disabled (benchmark_mem_conf_t)
     size_t max_mem_usage;
+    /// The peak increase in resident and, proportional set size, see benchmark_mem_conf_t
+    size_t max_rss_usage;
+    size_t max_pss_usage;
+    /// Page faults per run, set if the memory profile is enabled
+    size_t minor_faults;
+    size_t major_faults;
     /// The length of outputs used in the run
     size_t run_outputs_len;
     /// The output of all runs, users may want to get the mean, median or, mode later on.
@@ -109,9 +456,18 @@ typedef struct benchmark_profile_entry_t {
 typedef struct benchmark_profile_t {
     size_t len;
     benchmark_profile_entry_t *entries;
+    /// The params of every entry are in here
+    param_arena_t params_arena;
     benchmark_conf_t conf;
+    /// Captured before the runs, this is saved with JSON and, CSV outputs
+    benchmark_env_t env;
 } benchmark_profile_t;
 
+/// Reports the bytes or, items that the benchmarked function processed, call these from the function.
+/// The amounts are added up over a call so a batch can report each iteration or, the whole batch
+void benchmark_report_bytes(size_t bytes);
+void benchmark_report_items(size_t items);
+
 /// Runs a benchmark from a set of configurations, inputs are not cloned and, owned by the caller
 int benchmark_program(benchmark_conf_t *conf_bench, benchmark_profile_t *output_profile);
 
@@ -0,0 +1,11 @@
+#include "./bench_barrier.h"
+
+volatile uint64_t benchmark_black_hole_sink = 0;
+
+void benchmark_black_hole(const void *data, size_t len)
+{
+    const volatile unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        benchmark_black_hole_sink += bytes[i];
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Optimisation barriers for the functions that are benchmarked. An optimising build can delete work
+/// whose result is never used or, move it out of the timed region, these stop that without adding
+/// any instructions (other than the volatile fallbacks on compilers without GNU inline asm).
+
+/// Reads every byte of data through a volatile pointer, use this for results that are buffers.
+/// This is a call that the compiler cannot see into so the buffer has to be written first.
+void benchmark_black_hole(const void *data, size_t len);
+
+/// Used by the fallbacks when there is no inline asm
+extern volatile uint64_t benchmark_black_hole_sink;
+
+#if defined(__GNUC__) || defined(__clang__)
+/// Makes the compiler assume that x is read and, changed here so the work that made it is kept and,
+/// x cannot be treated as a constant afterwards. x has to be an lvalue
+#define BENCHMARK_DO_NOT_OPTIMIZE(x) __asm__ volatile("" : "+m"(x) : : "memory")
+
+/// Makes the compiler assume that all memory is read and, written here so pending stores are done
+/// before it and, loads are not moved across it
+#define BENCHMARK_CLOBBER_MEMORY() __asm__ volatile("" : : : "memory")
+
+/// Keeps a value that is not an lvalue, i.e: BENCHMARK_CONSUME(hash(key, len))
+#define BENCHMARK_CONSUME(value) \
+    do { \
+        __typeof__(value) benchmark_consumed_ = (value); \
+        BENCHMARK_DO_NOT_OPTIMIZE(benchmark_consumed_); \
+    } while (0)
+
+/// Makes the compiler assume that ptr escapes so what it points to has to be written
+static inline void benchmark_escape(const void *ptr)
+{
+    __asm__ volatile("" : : "g"(ptr) : "memory");
+}
+#else
+#define BENCHMARK_DO_NOT_OPTIMIZE(x) benchmark_black_hole(&(x), sizeof(x))
+#define BENCHMARK_CLOBBER_MEMORY() benchmark_black_hole(NULL, 0)
+/// Only numbers and, pointers can be consumed without inline asm
+#define BENCHMARK_CONSUME(value) (benchmark_black_hole_sink = (uint64_t) (value))
+
+static inline void benchmark_escape(const void *ptr)
+{
+    benchmark_black_hole(&ptr, sizeof(ptr));
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
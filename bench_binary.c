@@ -0,0 +1,295 @@
+#include "./bench_binary.h"
+#include "./testing.h/logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// run_outputs are written as is
+_Static_assert(sizeof(int) == sizeof(int32_t), "int must be 32 bits");
+// All of the fields are 8 bytes so the sections cannot have padding
+_Static_assert(sizeof(benchmark_binary_timing_t) == (46 + PERF_COUNTERS) * 8, "timing has padding");
+_Static_assert(sizeof(benchmark_binary_memory_t) == (9 + ALLOC_SIZE_CLASSES) * 8, "memory has padding");
+
+#define BINARY_ALIGN 8
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + BINARY_ALIGN - 1) & ~(uint64_t) (BINARY_ALIGN - 1);
+}
+
+static void write_padding(FILE *f, uint64_t offset)
+{
+    static const char zeros[BINARY_ALIGN] = {0};
+    fwrite(zeros, 1, align_offset(offset) - offset, f);
+}
+
+static void binary_stats(const benchmark_stats_t *stats, benchmark_binary_stats_t *output)
+{
+    output->min = stats->min;
+    output->max = stats->max;
+    output->mean = stats->mean;
+    output->stddev = stats->stddev;
+    output->p50 = stats->p50;
+    output->p90 = stats->p90;
+    output->p99 = stats->p99;
+    output->p999 = stats->p999;
+    output->mad = stats->mad;
+}
+
+static void binary_timing(benchmark_profile_entry_t *entry, benchmark_binary_timing_t *timing,
+                          uint64_t run_times_start, uint64_t run_outputs_start)
+{
+    memset(timing, 0, sizeof(*timing));
+    timing->runs = entry->runs;
+    timing->converged = entry->converged;
+    timing->status = entry->status;
+    timing->signal = entry->signal;
+    timing->cpu_time_us = entry->cpu_time_us;
+    timing->cpu_time_ns = entry->cpu_time_ns;
+    timing->op_time_ns = entry->op_time_ns;
+    timing->batch_iterations = entry->batch_iterations;
+    timing->batch_overhead_ns = entry->batch_overhead_ns;
+    timing->bytes_per_op = entry->bytes_per_op;
+    timing->items_per_op = entry->items_per_op;
+    timing->gb_per_s = entry->gb_per_s;
+    timing->items_per_s = entry->items_per_s;
+    timing->ns_per_item = entry->ns_per_item;
+    binary_stats(&entry->time_stats, &timing->time_stats);
+    timing->warmup_runs = entry->warmup_runs;
+    timing->cold_runs = entry->cold_runs;
+    binary_stats(&entry->cold_time_stats, &timing->cold_time_stats);
+    timing->perf.available = entry->perf.available;
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        timing->perf.counters[i] = entry->perf.counters[i];
+    }
+    timing->perf.ipc = entry->perf.ipc;
+    timing->scaling.threads = entry->scaling.threads;
+    timing->scaling.wall_time_ns = entry->scaling.wall_time_ns;
+    timing->scaling.throughput = entry->scaling.throughput;
+    timing->scaling.speedup = entry->scaling.speedup;
+    timing->scaling.efficiency = entry->scaling.efficiency;
+    timing->cpu_core_time_us = entry->cpu_core_time_us;
+    timing->run_times_start = run_times_start;
+    timing->run_times_len = entry->run_times_len;
+    timing->run_outputs_start = run_outputs_start;
+    timing->run_outputs_len = entry->run_outputs_len;
+}
+
+static void binary_memory(benchmark_profile_entry_t *entry, benchmark_binary_memory_t *memory)
+{
+    memset(memory, 0, sizeof(*memory));
+    memory->max_mem_usage = entry->max_mem_usage;
+    memory->max_rss_usage = entry->max_rss_usage;
+    memory->max_pss_usage = entry->max_pss_usage;
+    memory->minor_faults = entry->minor_faults;
+    memory->major_faults = entry->major_faults;
+    memory->allocs.peak_bytes = entry->allocs.peak_bytes;
+    memory->allocs.total_bytes = entry->allocs.total_bytes;
+    memory->allocs.allocations = entry->allocs.allocations;
+    memory->allocs.frees = entry->allocs.frees;
+    for (size_t i = 0; i < ALLOC_SIZE_CLASSES; i++) {
+        memory->allocs.size_classes[i] = entry->allocs.size_classes[i];
+    }
+}
+
+int save_benchmark_binary(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf)
+{
+    benchmark_binary_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BENCHMARK_BINARY_MAGIC, sizeof(header.magic));
+    header.version = BENCHMARK_BINARY_VERSION;
+    header.timing_size = sizeof(benchmark_binary_timing_t);
+    header.memory_size = sizeof(benchmark_binary_memory_t);
+    header.function_type = profile->conf.function_type;
+    header.runs_to_average = profile->conf.runs_to_average;
+    header.entries = profile->len;
+    if (profile->len > 0) {
+        header.dimensions = profile->entries[0].params.dimensions;
+        header.cpu_cores = profile->entries[0].cpu_cores;
+    }
+
+    for (size_t i = 0; i < profile->len; i++) {
+        benchmark_profile_entry_t *entry = &profile->entries[i];
+        if (entry->params.dimensions != header.dimensions) {
+            lprintf(LOG_ERROR, "Entries with different dimensions cannot be saved as binary\n");
+            return 0;
+        }
+        header.run_times_len += entry->run_times_len;
+        header.run_outputs_len += entry->run_outputs_len;
+    }
+
+    // Lay the sections out one after the other
+    header.params_offset = align_offset(sizeof(header));
+    header.timings_offset = align_offset(header.params_offset + sizeof(double) * header.entries * header.dimensions);
+    header.memory_offset = align_offset(header.timings_offset + sizeof(benchmark_binary_timing_t) * header.entries);
+    header.core_usage_offset = align_offset(header.memory_offset + sizeof(benchmark_binary_memory_t) * header.entries);
+    header.run_times_offset = align_offset(header.core_usage_offset + sizeof(uint64_t) * header.entries * header.cpu_cores);
+    header.run_outputs_offset = align_offset(header.run_times_offset + sizeof(uint64_t) * header.run_times_len);
+    header.file_len = header.run_outputs_offset + sizeof(int32_t) * header.run_outputs_len;
+
+    char name[255];
+    snprintf(name, sizeof(name), "%s.bench.bin", output_conf->output_file_prefix);
+    FILE *f = fopen(name, "wb");
+    if (f == NULL) {
+        lprintf(LOG_ERROR, "Cannot open output file %s\n", name);
+        return 0;
+    }
+
+    fwrite(&header, sizeof(header), 1, f);
+    write_padding(f, sizeof(header));
+
+    for (size_t i = 0; i < profile->len && header.dimensions > 0; i++) {
+        fwrite(profile->entries[i].params.values, sizeof(double), header.dimensions, f);
+    }
+    write_padding(f, header.params_offset + sizeof(double) * header.entries * header.dimensions);
+
+    uint64_t run_times_start = 0, run_outputs_start = 0;
+    for (size_t i = 0; i < profile->len; i++) {
+        benchmark_profile_entry_t *entry = &profile->entries[i];
+        benchmark_binary_timing_t timing;
+        binary_timing(entry, &timing, run_times_start, run_outputs_start);
+        fwrite(&timing, sizeof(timing), 1, f);
+        run_times_start += entry->run_times_len;
+        run_outputs_start += entry->run_outputs_len;
+    }
+
+    for (size_t i = 0; i < profile->len; i++) {
+        benchmark_binary_memory_t memory;
+        binary_memory(&profile->entries[i], &memory);
+        fwrite(&memory, sizeof(memory), 1, f);
+    }
+
+    // Cores that an entry does not have are 0
+    for (size_t i = 0; i < profile->len; i++) {
+        benchmark_profile_entry_t *entry = &profile->entries[i];
+        for (size_t j = 0; j < header.cpu_cores; j++) {
+            uint64_t usage = j < entry->cpu_cores ? entry->cpu_core_usage_us[j] : 0;
+            fwrite(&usage, sizeof(usage), 1, f);
+        }
+    }
+
+    for (size_t i = 0; i < profile->len; i++) {
+        benchmark_profile_entry_t *entry = &profile->entries[i];
+        // The array is NULL when it is empty
+        if (entry->run_times_len > 0) {
+            fwrite(entry->run_times_ns, sizeof(uint64_t), entry->run_times_len, f);
+        }
+    }
+
+    for (size_t i = 0; i < profile->len; i++) {
+        benchmark_profile_entry_t *entry = &profile->entries[i];
+        if (entry->run_outputs_len > 0) {
+            fwrite(entry->run_outputs, sizeof(int32_t), entry->run_outputs_len, f);
+        }
+    }
+
+    int failed = ferror(f);
+    failed |= fclose(f) != 0;
+    if (failed) {
+        lprintf(LOG_ERROR, "Cannot write to output file %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+/// Whether a section of count items of size bytes at offset fits in the file
+static int section_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_len)
+{
+    if (offset % BINARY_ALIGN != 0 || offset > file_len) {
+        return 0;
+    }
+    return size == 0 || count <= (file_len - offset) / size;
+}
+
+int open_benchmark_binary(benchmark_binary_t *bin, const char *filename)
+{
+    memset(bin, 0, sizeof(*bin));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        lprintf(LOG_ERROR, "Cannot open %s\n", filename);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(benchmark_binary_header_t)) {
+        lprintf(LOG_ERROR, "%s is too short to be a binary output\n", filename);
+        close(fd);
+        return 0;
+    }
+
+    bin->len = st.st_size;
+    bin->map = mmap(NULL, bin->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bin->map == MAP_FAILED) {
+        lprintf(LOG_ERROR, "Cannot mmap %s\n", filename);
+        bin->map = NULL;
+        return 0;
+    }
+
+    const benchmark_binary_header_t *header = bin->map;
+    int valid = memcmp(header->magic, BENCHMARK_BINARY_MAGIC, sizeof(header->magic)) == 0
+                && header->version == BENCHMARK_BINARY_VERSION
+                && header->timing_size == sizeof(benchmark_binary_timing_t)
+                && header->memory_size == sizeof(benchmark_binary_memory_t)
+                && header->file_len <= bin->len
+                && (header->dimensions == 0 || header->entries <= UINT64_MAX / header->dimensions)
+                && (header->cpu_cores == 0 || header->entries <= UINT64_MAX / header->cpu_cores);
+    valid = valid
+            && section_fits(header->params_offset, header->entries * header->dimensions, sizeof(double), header->file_len)
+            && section_fits(header->timings_offset, header->entries, sizeof(benchmark_binary_timing_t), header->file_len)
+            && section_fits(header->memory_offset, header->entries, sizeof(benchmark_binary_memory_t), header->file_len)
+            && section_fits(header->core_usage_offset, header->entries * header->cpu_cores, sizeof(uint64_t), header->file_len)
+            && section_fits(header->run_times_offset, header->run_times_len, sizeof(uint64_t), header->file_len)
+            && section_fits(header->run_outputs_offset, header->run_outputs_len, sizeof(int32_t), header->file_len);
+    if (!valid) {
+        lprintf(LOG_ERROR, "%s is not a valid binary output\n", filename);
+        close_benchmark_binary(bin);
+        return 0;
+    }
+
+    const char *base = bin->map;
+    bin->header = header;
+    bin->params = (const double *) (base + header->params_offset);
+    bin->timings = (const benchmark_binary_timing_t *) (base + header->timings_offset);
+    bin->memory = (const benchmark_binary_memory_t *) (base + header->memory_offset);
+    bin->core_usage_us = (const uint64_t *) (base + header->core_usage_offset);
+    bin->run_times_ns = (const uint64_t *) (base + header->run_times_offset);
+    bin->run_outputs = (const int32_t *) (base + header->run_outputs_offset);
+    return 1;
+}
+
+int benchmark_binary_entry(benchmark_binary_t *bin, size_t i, benchmark_binary_entry_t *entry)
+{
+    if (i >= bin->header->entries) {
+        return 0;
+    }
+
+    // The sample ranges of an entry are checked here as they are not checked when the file is opened
+    const benchmark_binary_timing_t *timing = &bin->timings[i];
+    if (timing->run_times_start > bin->header->run_times_len
+            || timing->run_times_len > bin->header->run_times_len - timing->run_times_start
+            || timing->run_outputs_start > bin->header->run_outputs_len
+            || timing->run_outputs_len > bin->header->run_outputs_len - timing->run_outputs_start) {
+        lprintf(LOG_ERROR, "Entry %lu has invalid samples\n", i);
+        return 0;
+    }
+
+    entry->params = &bin->params[i * bin->header->dimensions];
+    entry->timing = timing;
+    entry->memory = &bin->memory[i];
+    entry->cpu_core_usage_us = &bin->core_usage_us[i * bin->header->cpu_cores];
+    entry->run_times_ns = &bin->run_times_ns[timing->run_times_start];
+    entry->run_outputs = &bin->run_outputs[timing->run_outputs_start];
+    return 1;
+}
+
+void close_benchmark_binary(benchmark_binary_t *bin)
+{
+    if (bin->map != NULL) {
+        munmap(bin->map, bin->len);
+    }
+    memset(bin, 0, sizeof(*bin));
+}
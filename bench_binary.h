@@ -0,0 +1,166 @@
+#pragma once
+#include "./bench.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCHMARK_BINARY_MAGIC "BENCHBIN"
+#define BENCHMARK_BINARY_VERSION 2
+
+/// The header at the start of a .bench.bin file. The file is made of fixed width sections (columns)
+/// that each hold one kind of value for every entry, so they can be used straight from a mmap.
+/// Values are in host byte order and, each section starts at an 8 byte aligned offset. Every
+/// field of the section structs is 8 bytes wide so they have no padding and, do not depend on
+/// the in memory structs of bench.h, which can change without the file format changing.
+typedef struct benchmark_binary_header_t {
+    char magic[8];
+    uint32_t version;
+    /// sizeof the section structs, a reader with a different layout will not read the file
+    uint32_t timing_size;
+    uint32_t memory_size;
+    /// See benchmark_conf_t
+    uint32_t function_type;
+    uint64_t runs_to_average;
+    uint64_t entries;
+    /// The number of params of each entry
+    uint64_t dimensions;
+    /// The number of cores of each entry in the core usage section
+    uint64_t cpu_cores;
+    /// The total number of run times and, run outputs of all entries
+    uint64_t run_times_len;
+    uint64_t run_outputs_len;
+    /// The offsets of the sections from the start of the file
+    uint64_t params_offset;
+    uint64_t timings_offset;
+    uint64_t memory_offset;
+    uint64_t core_usage_offset;
+    uint64_t run_times_offset;
+    uint64_t run_outputs_offset;
+    uint64_t file_len;
+} benchmark_binary_header_t;
+
+/// See benchmark_stats_t
+typedef struct benchmark_binary_stats_t {
+    uint64_t min;
+    uint64_t max;
+    double mean;
+    double stddev;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t mad;
+} benchmark_binary_stats_t;
+
+/// See benchmark_perf_t
+typedef struct benchmark_binary_perf_t {
+    uint64_t available;
+    double counters[PERF_COUNTERS];
+    double ipc;
+} benchmark_binary_perf_t;
+
+/// See benchmark_scaling_t
+typedef struct benchmark_binary_scaling_t {
+    uint64_t threads;
+    uint64_t wall_time_ns;
+    double throughput;
+    double speedup;
+    double efficiency;
+} benchmark_binary_scaling_t;
+
+/// See benchmark_alloc_t
+typedef struct benchmark_binary_alloc_t {
+    uint64_t peak_bytes;
+    double total_bytes;
+    double allocations;
+    double frees;
+    double size_classes[ALLOC_SIZE_CLASSES];
+} benchmark_binary_alloc_t;
+
+/// The timings of an entry, see benchmark_profile_entry_t for what each field is
+typedef struct benchmark_binary_timing_t {
+    uint64_t runs;
+    uint64_t converged;
+    /// A benchmark_entry_status_t
+    uint64_t status;
+    int64_t signal;
+    uint64_t cpu_time_us;
+    uint64_t cpu_time_ns;
+    double op_time_ns;
+    uint64_t batch_iterations;
+    double batch_overhead_ns;
+    double bytes_per_op;
+    double items_per_op;
+    double gb_per_s;
+    double items_per_s;
+    double ns_per_item;
+    benchmark_binary_stats_t time_stats;
+    uint64_t warmup_runs;
+    uint64_t cold_runs;
+    benchmark_binary_stats_t cold_time_stats;
+    benchmark_binary_perf_t perf;
+    benchmark_binary_scaling_t scaling;
+    uint64_t cpu_core_time_us;
+    /// The index of the first run time of the entry in the run times section and, the count
+    uint64_t run_times_start;
+    uint64_t run_times_len;
+    /// The index of the first run output of the entry in the run outputs section and, the count
+    uint64_t run_outputs_start;
+    uint64_t run_outputs_len;
+} benchmark_binary_timing_t;
+
+/// The memory usage of an entry, see benchmark_profile_entry_t for what each field is
+typedef struct benchmark_binary_memory_t {
+    uint64_t max_mem_usage;
+    uint64_t max_rss_usage;
+    uint64_t max_pss_usage;
+    uint64_t minor_faults;
+    uint64_t major_faults;
+    benchmark_binary_alloc_t allocs;
+} benchmark_binary_memory_t;
+
+/// A .bench.bin file that is mapped into memory, the pointers are into the mapping
+typedef struct benchmark_binary_t {
+    void *map;
+    size_t len;
+    const benchmark_binary_header_t *header;
+    /// header->entries * header->dimensions
+    const double *params;
+    const benchmark_binary_timing_t *timings;
+    const benchmark_binary_memory_t *memory;
+    /// header->entries * header->cpu_cores
+    const uint64_t *core_usage_us;
+    const uint64_t *run_times_ns;
+    const int32_t *run_outputs;
+} benchmark_binary_t;
+
+/// An entry of a benchmark_binary_t, nothing is copied so this is only valid until the file is closed
+typedef struct benchmark_binary_entry_t {
+    /// header->dimensions long
+    const double *params;
+    const benchmark_binary_timing_t *timing;
+    const benchmark_binary_memory_t *memory;
+    /// header->cpu_cores long
+    const uint64_t *cpu_core_usage_us;
+    /// timing->run_times_len long
+    const uint64_t *run_times_ns;
+    /// timing->run_outputs_len long
+    const int32_t *run_outputs;
+} benchmark_binary_entry_t;
+
+/// Saves a profile as <prefix>.bench.bin
+int save_benchmark_binary(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf);
+
+/// Maps a file that was saved with OUTPUT_BINARY, it is checked before it is used. 0 on failure
+int open_benchmark_binary(benchmark_binary_t *bin, const char *filename);
+
+/// Gets entry i of the file, 0 if i is out of range
+int benchmark_binary_entry(benchmark_binary_t *bin, size_t i, benchmark_binary_entry_t *entry);
+
+void close_benchmark_binary(benchmark_binary_t *bin);
+
+#ifdef __cplusplus
+}
+#endif
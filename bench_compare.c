@@ -0,0 +1,515 @@
+#include "./bench_compare.h"
+#include "./bench_binary.h"
+#include "./testing.h/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <jansson.h>
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double sorted_median(uint64_t *sorted, size_t len)
+{
+    if (len % 2 == 1) {
+        return sorted[len / 2];
+    }
+    return ((double) sorted[len / 2 - 1] + sorted[len / 2]) / 2;
+}
+
+/// Copies the params and, samples into a result, the median is found from the samples if there are any
+static int init_benchmark_result(benchmark_result_t *result, const double *params, size_t dimensions,
+                                 const uint64_t *samples, size_t samples_len)
+{
+    result->params.dimensions = dimensions;
+    result->params.values = malloc(sizeof(*params) * (dimensions > 0 ? dimensions : 1));
+    result->samples_len = samples_len;
+    result->samples_ns = malloc(sizeof(*samples) * (samples_len > 0 ? samples_len : 1));
+    if (result->params.values == NULL || result->samples_ns == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc result\n");
+        return 0;
+    }
+
+    memcpy(result->params.values, params, sizeof(*params) * dimensions);
+    if (samples_len > 0) {
+        memcpy(result->samples_ns, samples, sizeof(*samples) * samples_len);
+        qsort(result->samples_ns, samples_len, sizeof(*result->samples_ns), &cmp_u64);
+        result->median_ns = sorted_median(result->samples_ns, samples_len);
+    }
+    return 1;
+}
+
+/// Adds an entry to the end of the results, NULL on failure
+static benchmark_result_t *add_benchmark_result(benchmark_results_t *results, size_t *capacity)
+{
+    if (results->len == *capacity) {
+        size_t new_capacity = *capacity == 0 ? 64 : *capacity * 2;
+        benchmark_result_t *entries = realloc(results->entries, sizeof(*entries) * new_capacity);
+        if (entries == NULL) {
+            lprintf(LOG_ERROR, "Cannot realloc results\n");
+            return NULL;
+        }
+        results->entries = entries;
+        *capacity = new_capacity;
+    }
+
+    benchmark_result_t *result = &results->entries[results->len++];
+    memset(result, 0, sizeof(*result));
+    return result;
+}
+
+/// Reads an entry that was made by benchmark_entry_json
+static int load_json_result(benchmark_results_t *results, size_t *capacity, json_t *node)
+{
+    json_t *params_node = json_object_get(node, "params");
+    json_t *samples_node = json_object_get(node, "run_times_ns");
+    json_t *stats_node = json_object_get(node, "time_stats_ns");
+    if (!json_is_array(params_node) || !json_is_array(samples_node) || !json_is_object(stats_node)) {
+        lprintf(LOG_ERROR, "Entry is missing params, run_times_ns or, time_stats_ns\n");
+        return 0;
+    }
+
+    size_t dimensions = json_array_size(params_node);
+    size_t samples_len = json_array_size(samples_node);
+    double params[dimensions > 0 ? dimensions : 1];
+    uint64_t *samples = malloc(sizeof(*samples) * (samples_len > 0 ? samples_len : 1));
+    if (samples == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc samples\n");
+        return 0;
+    }
+
+    for (size_t i = 0; i < dimensions; i++) {
+        params[i] = json_number_value(json_array_get(params_node, i));
+    }
+    for (size_t i = 0; i < samples_len; i++) {
+        samples[i] = json_integer_value(json_array_get(samples_node, i));
+    }
+
+    benchmark_result_t *result = add_benchmark_result(results, capacity);
+    int ret = result != NULL && init_benchmark_result(result, params, dimensions, samples, samples_len);
+    free(samples);
+    if (!ret) {
+        return 0;
+    }
+
+    result->runs = json_integer_value(json_object_get(node, "runs"));
+    result->iterations = json_integer_value(json_object_get(node, "batch_iterations"));
+    result->mean_ns = json_number_value(json_object_get(stats_node, "mean"));
+    result->stddev_ns = json_number_value(json_object_get(stats_node, "stddev"));
+    if (samples_len == 0) {
+        result->median_ns = json_number_value(json_object_get(stats_node, "p50"));
+    }
+    return 1;
+}
+
+static int load_json_results(benchmark_results_t *results, const char *filename)
+{
+    json_error_t error;
+    json_t *root = json_load_file(filename, 0, &error);
+    if (root == NULL) {
+        lprintf(LOG_ERROR, "Cannot read %s: %s\n", filename, error.text);
+        return 0;
+    }
+
+    // Older files are only the array of entries, newer ones have it in an object with the environment
+    json_t *entries = json_is_object(root) ? json_object_get(root, "entries") : root;
+    int ret = json_is_array(entries);
+    if (!ret) {
+        lprintf(LOG_ERROR, "%s does not have an array of entries\n", filename);
+    }
+
+    size_t capacity = 0;
+    for (size_t i = 0; ret && i < json_array_size(entries); i++) {
+        ret = load_json_result(results, &capacity, json_array_get(entries, i));
+    }
+    json_decref(root);
+    return ret;
+}
+
+static int load_ndjson_results(benchmark_results_t *results, const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        lprintf(LOG_ERROR, "Cannot open %s\n", filename);
+        return 0;
+    }
+
+    int ret = 1;
+    size_t capacity = 0, line_len = 0;
+    char *line = NULL;
+    while (ret && getline(&line, &line_len, f) > 0) {
+        json_error_t error;
+        json_t *node = json_loads(line, 0, &error);
+        if (node == NULL) {
+            lprintf(LOG_ERROR, "Cannot read %s: %s\n", filename, error.text);
+            ret = 0;
+            break;
+        }
+        ret = load_json_result(results, &capacity, node);
+        json_decref(node);
+    }
+
+    free(line);
+    fclose(f);
+    return ret;
+}
+
+/// The columns of a CSV header that are used, -1 if they are not present
+typedef struct csv_columns_t {
+    size_t dimensions;
+    int mean;
+    int stddev;
+    int p50;
+    int runs;
+    int iterations;
+} csv_columns_t;
+
+static void read_csv_columns(char *header, csv_columns_t *columns)
+{
+    memset(columns, -1, sizeof(*columns));
+    columns->dimensions = 0;
+
+    int i = 0;
+    for (char *save, *col = strtok_r(header, ",\n", &save); col != NULL; col = strtok_r(NULL, ",\n", &save), i++) {
+        if (col[0] == 'v' && i == (int) columns->dimensions) {
+            columns->dimensions++;
+        } else if (strcmp(col, "mean_ns") == 0) {
+            columns->mean = i;
+        } else if (strcmp(col, "stddev_ns") == 0) {
+            columns->stddev = i;
+        } else if (strcmp(col, "p50_ns") == 0) {
+            columns->p50 = i;
+        } else if (strcmp(col, "runs") == 0) {
+            columns->runs = i;
+        } else if (strcmp(col, "batch_iterations") == 0) {
+            columns->iterations = i;
+        }
+    }
+}
+
+/// CSV files only have the statistics of the runs so the results have no samples
+static int load_csv_results(benchmark_results_t *results, const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        lprintf(LOG_ERROR, "Cannot open %s\n", filename);
+        return 0;
+    }
+
+    size_t capacity = 0, line_len = 0;
+    char *line = NULL;
+    csv_columns_t columns;
+    // The environment is in comment lines before the header
+    int ret;
+    while ((ret = getline(&line, &line_len, f) > 0) && line[0] == '#');
+    if (ret) {
+        read_csv_columns(line, &columns);
+        ret = columns.mean >= 0 && columns.stddev >= 0 && columns.p50 >= 0 && columns.runs >= 0;
+    }
+    if (!ret) {
+        lprintf(LOG_ERROR, "%s does not have a valid header\n", filename);
+    }
+
+    while (ret && getline(&line, &line_len, f) > 0) {
+        double params[columns.dimensions > 0 ? columns.dimensions : 1];
+        double mean = 0, stddev = 0, p50 = 0, runs = 0, iterations = 0;
+
+        // Empty columns (unavailable perf counters) are kept as strsep does not merge delimiters
+        char *rest = line;
+        int i = 0;
+        for (char *col = strsep(&rest, ","); col != NULL; col = strsep(&rest, ","), i++) {
+            if (i < (int) columns.dimensions) {
+                params[i] = strtod(col, NULL);
+            } else if (i == columns.mean) {
+                mean = strtod(col, NULL);
+            } else if (i == columns.stddev) {
+                stddev = strtod(col, NULL);
+            } else if (i == columns.p50) {
+                p50 = strtod(col, NULL);
+            } else if (i == columns.runs) {
+                runs = strtod(col, NULL);
+            } else if (i == columns.iterations) {
+                iterations = strtod(col, NULL);
+            }
+        }
+
+        benchmark_result_t *result = add_benchmark_result(results, &capacity);
+        ret = result != NULL && init_benchmark_result(result, params, columns.dimensions, NULL, 0);
+        if (ret) {
+            result->mean_ns = mean;
+            result->stddev_ns = stddev;
+            result->median_ns = p50;
+            result->runs = runs;
+            result->iterations = iterations;
+        }
+    }
+
+    free(line);
+    fclose(f);
+    return ret;
+}
+
+static int load_binary_results(benchmark_results_t *results, const char *filename)
+{
+    benchmark_binary_t bin;
+    if (!open_benchmark_binary(&bin, filename)) {
+        return 0;
+    }
+
+    int ret = 1;
+    size_t capacity = 0;
+    for (size_t i = 0; ret && i < bin.header->entries; i++) {
+        benchmark_binary_entry_t entry;
+        ret = benchmark_binary_entry(&bin, i, &entry);
+        if (!ret) {
+            break;
+        }
+
+        benchmark_result_t *result = add_benchmark_result(results, &capacity);
+        ret = result != NULL && init_benchmark_result(result, entry.params, bin.header->dimensions,
+                                                      entry.run_times_ns, entry.timing->run_times_len);
+        if (ret) {
+            result->runs = entry.timing->runs;
+            result->iterations = entry.timing->batch_iterations;
+            result->mean_ns = entry.timing->time_stats.mean;
+            result->stddev_ns = entry.timing->time_stats.stddev;
+            if (result->samples_len == 0) {
+                result->median_ns = entry.timing->time_stats.p50;
+            }
+        }
+    }
+
+    close_benchmark_binary(&bin);
+    return ret;
+}
+
+static int has_suffix(const char *str, const char *suffix)
+{
+    size_t len = strlen(str), suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+int load_benchmark_results(benchmark_results_t *results, const char *filename)
+{
+    results->len = 0;
+    results->entries = NULL;
+
+    int ret;
+    if (has_suffix(filename, ".ndjson")) {
+        ret = load_ndjson_results(results, filename);
+    } else if (has_suffix(filename, ".json")) {
+        ret = load_json_results(results, filename);
+    } else if (has_suffix(filename, ".csv")) {
+        ret = load_csv_results(results, filename);
+    } else if (has_suffix(filename, ".bin")) {
+        ret = load_binary_results(results, filename);
+    } else {
+        lprintf(LOG_ERROR, "Cannot find the output type of %s\n", filename);
+        ret = 0;
+    }
+
+    if (!ret) {
+        free_benchmark_results(results);
+    }
+    return ret;
+}
+
+void free_benchmark_results(benchmark_results_t *results)
+{
+    for (size_t i = 0; i < results->len; i++) {
+        free(results->entries[i].params.values);
+        free(results->entries[i].samples_ns);
+    }
+    free(results->entries);
+    results->len = 0;
+    results->entries = NULL;
+}
+
+void init_benchmark_compare_conf(benchmark_compare_conf_t *conf)
+{
+    conf->threshold = 0.03;
+    conf->alpha = 0.01;
+}
+
+double mann_whitney_u_test(uint64_t *a, size_t a_len, uint64_t *b, size_t b_len)
+{
+    if (a_len == 0 || b_len == 0) {
+        return 1;
+    }
+
+    uint64_t *sorted_a = malloc(sizeof(*a) * (a_len + b_len));
+    if (sorted_a == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc samples\n");
+        return 1;
+    }
+    uint64_t *sorted_b = sorted_a + a_len;
+    memcpy(sorted_a, a, sizeof(*a) * a_len);
+    memcpy(sorted_b, b, sizeof(*b) * b_len);
+    qsort(sorted_a, a_len, sizeof(*a), &cmp_u64);
+    qsort(sorted_b, b_len, sizeof(*b), &cmp_u64);
+
+    // Merge the samples to rank them, tied values get the mean of their ranks
+    double rank_sum = 0, ties = 0, rank = 1;
+    size_t i = 0, j = 0;
+    while (i < a_len || j < b_len) {
+        uint64_t val = j >= b_len || (i < a_len && sorted_a[i] < sorted_b[j]) ? sorted_a[i] : sorted_b[j];
+        size_t a_ties = 0, b_ties = 0;
+        for (; i < a_len && sorted_a[i] == val; i++, a_ties++);
+        for (; j < b_len && sorted_b[j] == val; j++, b_ties++);
+
+        double t = a_ties + b_ties;
+        rank_sum += a_ties * (rank + (t - 1) / 2);
+        ties += t * t * t - t;
+        rank += t;
+    }
+    free(sorted_a);
+
+    double n = a_len + b_len;
+    double u = rank_sum - (double) a_len * (a_len + 1) / 2;
+    double mean = (double) a_len * b_len / 2;
+    double variance = (double) a_len * b_len / 12 * ((n + 1) - ties / (n * (n - 1)));
+    if (variance <= 0) {
+        return 1;
+    }
+
+    // With a continuity correction
+    double z = fmax(fabs(u - mean) - 0.5, 0) / sqrt(variance);
+    return erfc(z / M_SQRT2);
+}
+
+/// The iterations of each run of a result, 1 if it is not a batch
+static double result_iterations(benchmark_result_t *result)
+{
+    return result->iterations > 0 ? result->iterations : 1;
+}
+
+static double welch_test(benchmark_result_t *a, benchmark_result_t *b)
+{
+    if (a->runs < 2 || b->runs < 2) {
+        return 1;
+    }
+
+    double a_iterations = result_iterations(a), b_iterations = result_iterations(b);
+    double a_mean = a->mean_ns / a_iterations, b_mean = b->mean_ns / b_iterations;
+    double a_stddev = a->stddev_ns / a_iterations, b_stddev = b->stddev_ns / b_iterations;
+    double se = sqrt(a_stddev * a_stddev / a->runs + b_stddev * b_stddev / b->runs);
+    if (se <= 0) {
+        return a_mean == b_mean ? 1 : 0;
+    }
+    return erfc(fabs(a_mean - b_mean) / se / M_SQRT2);
+}
+
+/// Tests the samples of two results, when the batches have a different number of iterations the
+/// samples are scaled by the iterations of the other result so they are ranked per iteration
+/// without dividing them
+static double samples_test(benchmark_result_t *a, benchmark_result_t *b)
+{
+    size_t a_iterations = result_iterations(a), b_iterations = result_iterations(b);
+    if (a_iterations == b_iterations) {
+        return mann_whitney_u_test(a->samples_ns, a->samples_len, b->samples_ns, b->samples_len);
+    }
+
+    uint64_t *scaled_a = malloc(sizeof(*scaled_a) * (a->samples_len + b->samples_len));
+    if (scaled_a == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc samples\n");
+        return 1;
+    }
+    uint64_t *scaled_b = scaled_a + a->samples_len;
+    for (size_t i = 0; i < a->samples_len; i++) {
+        scaled_a[i] = a->samples_ns[i] * b_iterations;
+    }
+    for (size_t i = 0; i < b->samples_len; i++) {
+        scaled_b[i] = b->samples_ns[i] * a_iterations;
+    }
+
+    double p_value = mann_whitney_u_test(scaled_a, a->samples_len, scaled_b, b->samples_len);
+    free(scaled_a);
+    return p_value;
+}
+
+/// Params are saved as text in CSV files so they are compared with a tolerance
+static int cmp_params(const vector_t *a, const vector_t *b)
+{
+    if (a->dimensions != b->dimensions) {
+        return (a->dimensions > b->dimensions) - (a->dimensions < b->dimensions);
+    }
+
+    for (size_t i = 0; i < a->dimensions; i++) {
+        double x = a->values[i], y = b->values[i];
+        if (fabs(x - y) > 1e-6 * fmax(1, fmax(fabs(x), fabs(y)))) {
+            return (x > y) - (x < y);
+        }
+    }
+    return 0;
+}
+
+static int cmp_result_params(const void *a, const void *b)
+{
+    return cmp_params(&(*(benchmark_result_t *const *) a)->params, &(*(benchmark_result_t *const *) b)->params);
+}
+
+int compare_benchmark_results(benchmark_results_t *baseline, benchmark_results_t *candidate,
+                              benchmark_compare_conf_t *conf, benchmark_compare_t *compare)
+{
+    memset(compare, 0, sizeof(*compare));
+    compare->entries = malloc(sizeof(*compare->entries) * (baseline->len > 0 ? baseline->len : 1));
+    benchmark_result_t **sorted = malloc(sizeof(*sorted) * (candidate->len > 0 ? candidate->len : 1));
+    if (compare->entries == NULL || sorted == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc comparison\n");
+        free(compare->entries);
+        free(sorted);
+        compare->entries = NULL;
+        return 0;
+    }
+
+    // The candidate is sorted by params so each baseline entry can be found with a binary search
+    for (size_t i = 0; i < candidate->len; i++) {
+        sorted[i] = &candidate->entries[i];
+    }
+    qsort(sorted, candidate->len, sizeof(*sorted), &cmp_result_params);
+
+    for (size_t i = 0; i < baseline->len; i++) {
+        benchmark_result_t *base = &baseline->entries[i];
+        benchmark_result_t **found = bsearch(&base, sorted, candidate->len, sizeof(*sorted), &cmp_result_params);
+        if (found == NULL) {
+            compare->unmatched++;
+            continue;
+        }
+
+        benchmark_result_t *cand = *found;
+        benchmark_comparison_t *cmp = &compare->entries[compare->len++];
+        cmp->params = base->params;
+        cmp->baseline_ns = base->median_ns / result_iterations(base);
+        cmp->candidate_ns = cand->median_ns / result_iterations(cand);
+        cmp->change = cmp->baseline_ns > 0 ? cmp->candidate_ns / cmp->baseline_ns - 1 : 0;
+        if (base->samples_len > 0 && cand->samples_len > 0) {
+            cmp->p_value = samples_test(base, cand);
+        } else {
+            cmp->p_value = welch_test(base, cand);
+        }
+
+        // A change has to be significant and, larger than the threshold so noise is not reported
+        cmp->verdict = VERDICT_SAME;
+        if (base->runs < 2 || cand->runs < 2) {
+            cmp->verdict = VERDICT_UNTESTED;
+            compare->untested++;
+        } else if (cmp->p_value < conf->alpha && fabs(cmp->change) > conf->threshold) {
+            cmp->verdict = cmp->change > 0 ? VERDICT_SLOWER : VERDICT_FASTER;
+        }
+        compare->regressions += cmp->verdict == VERDICT_SLOWER;
+        compare->improvements += cmp->verdict == VERDICT_FASTER;
+    }
+
+    free(sorted);
+    return 1;
+}
+
+void free_benchmark_compare(benchmark_compare_t *compare)
+{
+    free(compare->entries);
+    memset(compare, 0, sizeof(*compare));
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "./ranges.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// An entry of a saved profile, only the parts that are needed to compare it are loaded
+typedef struct benchmark_result_t {
+    /// The values are owned by the result
+    vector_t params;
+    size_t runs;
+    double mean_ns;
+    double stddev_ns;
+    double median_ns;
+    /// The time of each run, CSV files do not have these so samples_len is 0 for them
+    size_t samples_len;
+    uint64_t *samples_ns;
+    /// The iterations of each run of a batch, the times are of the whole run so they are divided by
+    /// this when they are compared. 0 if the entry is not a batch
+    size_t iterations;
+} benchmark_result_t;
+
+typedef struct benchmark_results_t {
+    size_t len;
+    benchmark_result_t *entries;
+} benchmark_results_t;
+
+/// Loads a profile that was saved with save_benchmark, the type is found from the file extension
+/// (.bench.json, .bench.ndjson, .bench.csv or, .bench.bin). 0 on failure
+int load_benchmark_results(benchmark_results_t *results, const char *filename);
+void free_benchmark_results(benchmark_results_t *results);
+
+typedef struct benchmark_compare_conf_t {
+    /// The relative change in the median time that is reported, 0.03 is a 3% change
+    double threshold;
+    /// The p value below which a change is significant, i.e: 0.01
+    double alpha;
+} benchmark_compare_conf_t;
+
+/// Sets the default threshold (3%) and, alpha (0.01)
+void init_benchmark_compare_conf(benchmark_compare_conf_t *conf);
+
+typedef enum benchmark_verdict_t {
+    /// The change is not significant or, is within the threshold
+    VERDICT_SAME,
+    VERDICT_FASTER,
+    VERDICT_SLOWER,
+    /// Either entry has less than 2 runs (0 if it crashed) so there is nothing to test
+    VERDICT_UNTESTED
+} benchmark_verdict_t;
+
+typedef struct benchmark_comparison_t {
+    /// Points into the baseline results
+    vector_t params;
+    /// The median time of a run, or of an iteration for batches
+    double baseline_ns;
+    double candidate_ns;
+    /// candidate_ns / baseline_ns - 1, negative is faster
+    double change;
+    /// The two sided p value of a Mann-Whitney U test on the run times. When either file does not
+    /// have run times a Welch test on the mean, standard deviation and, run count is used instead
+    double p_value;
+    benchmark_verdict_t verdict;
+} benchmark_comparison_t;
+
+typedef struct benchmark_compare_t {
+    /// One per baseline entry that has an entry with the same params in the candidate
+    size_t len;
+    benchmark_comparison_t *entries;
+    size_t regressions;
+    size_t improvements;
+    /// Entries that have too few runs to be tested
+    size_t untested;
+    /// Baseline entries that are not in the candidate
+    size_t unmatched;
+} benchmark_compare_t;
+
+/// Compares each baseline entry with the candidate entry that has the same params. The results
+/// have to outlive the comparison. 0 on failure
+int compare_benchmark_results(benchmark_results_t *baseline, benchmark_results_t *candidate,
+                              benchmark_compare_conf_t *conf, benchmark_compare_t *compare);
+void free_benchmark_compare(benchmark_compare_t *compare);
+
+/// The two sided p value of a Mann-Whitney U test, the normal approximation with a tie
+/// correction is used. 1 if either sample is empty
+double mann_whitney_u_test(uint64_t *a, size_t a_len, uint64_t *b, size_t b_len);
+
+#ifdef __cplusplus
+}
+#endif
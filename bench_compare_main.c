@@ -0,0 +1,121 @@
+#include "./bench_compare.h"
+#include "./testing.h/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// Exit codes, a regression is 1 so this can be used as a CI gate
+#define EXIT_REGRESSION 1
+#define EXIT_USAGE 2
+/// Baseline entries that are not in the candidate
+#define EXIT_MISSING 3
+/// Entries with less than 2 runs, i.e: the benchmark crashed
+#define EXIT_UNTESTED 4
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t threshold] [-a alpha] [-q] baseline candidate\n"
+            "Compares two saved benchmarks (.bench.json, .bench.ndjson, .bench.csv or, .bench.bin)\n"
+            "  -t  the relative change in the median that is reported (default 0.03)\n"
+            "  -a  the p value below which a change is significant (default 0.01)\n"
+            "  -q  only print entries that changed\n"
+            "Exits with %d if any entry is slower, %d if any baseline entry is not in the candidate or,\n"
+            "%d if any entry has less than 2 runs\n", name, EXIT_REGRESSION, EXIT_MISSING, EXIT_UNTESTED);
+}
+
+static const char *verdict_name(benchmark_verdict_t verdict)
+{
+    switch (verdict) {
+    case VERDICT_FASTER:
+        return "faster";
+    case VERDICT_SLOWER:
+        return "SLOWER";
+    case VERDICT_UNTESTED:
+        return "UNTESTED";
+    default:
+        return "same";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    benchmark_compare_conf_t conf;
+    init_benchmark_compare_conf(&conf);
+    int quiet = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:a:qh")) != -1) {
+        switch (opt) {
+        case 't':
+            conf.threshold = atof(optarg);
+            break;
+        case 'a':
+            conf.alpha = atof(optarg);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_USAGE;
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    benchmark_results_t baseline, candidate;
+    if (!load_benchmark_results(&baseline, argv[optind])) {
+        return EXIT_USAGE;
+    }
+    if (!load_benchmark_results(&candidate, argv[optind + 1])) {
+        free_benchmark_results(&baseline);
+        return EXIT_USAGE;
+    }
+
+    benchmark_compare_t compare;
+    if (!compare_benchmark_results(&baseline, &candidate, &conf, &compare)) {
+        free_benchmark_results(&baseline);
+        free_benchmark_results(&candidate);
+        return EXIT_USAGE;
+    }
+
+    for (size_t i = 0; i < compare.len; i++) {
+        benchmark_comparison_t *cmp = &compare.entries[i];
+        if (quiet && cmp->verdict == VERDICT_SAME) {
+            continue;
+        }
+
+        printf("[");
+        for (size_t j = 0; j < cmp->params.dimensions; j++) {
+            printf(j == 0 ? "%g" : ", %g", cmp->params.values[j]);
+        }
+        printf("] %.2lf ns -> %.2lf ns %+.2lf%% p=%.3g %s\n", cmp->baseline_ns, cmp->candidate_ns,
+               cmp->change * 100, cmp->p_value, verdict_name(cmp->verdict));
+    }
+
+    printf("%lu compared, %lu slower, %lu faster, %lu untested, %lu not in the candidate\n",
+           compare.len, compare.regressions, compare.improvements, compare.untested, compare.unmatched);
+    if (compare.unmatched > 0) {
+        lprintf(LOG_WARNING, "%lu baseline entries are not in the candidate\n", compare.unmatched);
+    }
+    if (compare.untested > 0) {
+        lprintf(LOG_WARNING, "%lu entries have less than 2 runs\n", compare.untested);
+    }
+
+    // A missing or, crashed entry could be hiding a regression so they fail the gate too
+    int ret = 0;
+    if (compare.regressions > 0) {
+        ret = EXIT_REGRESSION;
+    } else if (compare.unmatched > 0) {
+        ret = EXIT_MISSING;
+    } else if (compare.untested > 0) {
+        ret = EXIT_UNTESTED;
+    }
+    free_benchmark_compare(&compare);
+    free_benchmark_results(&baseline);
+    free_benchmark_results(&candidate);
+    return ret;
+}
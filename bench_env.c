@@ -0,0 +1,166 @@
+#include "./bench_env.h"
+#include "./testing.h/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+// These are set by CMakeLists.txt
+#ifndef GIT_COMMIT_HASH
+#define GIT_COMMIT_HASH "unknown"
+#endif
+#ifndef VERSION
+#define VERSION "unknown"
+#endif
+#ifndef BENCHMARK_COMPILER_FLAGS
+#define BENCHMARK_COMPILER_FLAGS "unknown"
+#endif
+
+// Clang's version string has its name in it
+#if defined(__clang__)
+#define COMPILER_VERSION __VERSION__
+#elif defined(__GNUC__)
+#define COMPILER_VERSION "gcc " __VERSION__
+#else
+#define COMPILER_VERSION "unknown"
+#endif
+
+#define UNKNOWN "unknown"
+#define DEFAULT_MAX_LOAD 0.25
+
+/// Reads the first line of a file without the new line, 0 if it cannot be read
+static int read_first_line(const char *name, char *buffer, size_t len)
+{
+    FILE *f = fopen(name, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    int ret = fgets(buffer, len, f) != NULL;
+    fclose(f);
+    if (ret) {
+        buffer[strcspn(buffer, "\n")] = 0;
+    }
+    return ret;
+}
+
+/// Reads a file that holds a number, BENCHMARK_ENV_UNKNOWN if it cannot be read
+static int read_int_file(const char *name)
+{
+    char buffer[32];
+    if (!read_first_line(name, buffer, sizeof(buffer))) {
+        return BENCHMARK_ENV_UNKNOWN;
+    }
+    return atoi(buffer);
+}
+
+static void read_cpu_model(char *buffer, size_t len)
+{
+    snprintf(buffer, len, UNKNOWN);
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (f == NULL) {
+        return;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        // x86 has a model name, some arm kernels only have a Hardware line
+        if (strncmp(line, "model name", 10) == 0 || strncmp(line, "Hardware", 8) == 0) {
+            char *value = strchr(line, ':');
+            if (value != NULL) {
+                value += strspn(value, ": \t");
+                value[strcspn(value, "\n")] = 0;
+                snprintf(buffer, len, "%s", value);
+            }
+            break;
+        }
+    }
+    fclose(f);
+}
+
+/// intel_pstate has a no_turbo knob, acpi-cpufreq and, amd-pstate have a boost knob
+static int read_turbo()
+{
+    int no_turbo = read_int_file("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    if (no_turbo != BENCHMARK_ENV_UNKNOWN) {
+        return !no_turbo;
+    }
+    return read_int_file("/sys/devices/system/cpu/cpufreq/boost");
+}
+
+int capture_benchmark_env(benchmark_env_t *env)
+{
+    if (env == NULL) {
+        return 0;
+    }
+
+    memset(env, 0, sizeof(*env));
+    env->captured = 1;
+    env->timestamp = time(NULL);
+    if (gethostname(env->hostname, sizeof(env->hostname)) != 0) {
+        snprintf(env->hostname, sizeof(env->hostname), UNKNOWN);
+    }
+    env->hostname[sizeof(env->hostname) - 1] = 0;
+
+    read_cpu_model(env->cpu_model, sizeof(env->cpu_model));
+    env->cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (!read_first_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", env->governor, sizeof(env->governor))) {
+        snprintf(env->governor, sizeof(env->governor), UNKNOWN);
+    }
+    env->turbo = read_turbo();
+    env->smt = read_int_file("/sys/devices/system/cpu/smt/active");
+    env->aslr = read_int_file("/proc/sys/kernel/randomize_va_space");
+
+    struct utsname name;
+    if (uname(&name) == 0) {
+        snprintf(env->kernel, sizeof(env->kernel), "%s %s %s", name.sysname, name.release, name.machine);
+    } else {
+        snprintf(env->kernel, sizeof(env->kernel), UNKNOWN);
+    }
+
+    if (getloadavg(env->load_avg, 3) != 3) {
+        for (size_t i = 0; i < 3; i++) {
+            env->load_avg[i] = BENCHMARK_ENV_UNKNOWN;
+        }
+    }
+
+    snprintf(env->compiler, sizeof(env->compiler), "%s", COMPILER_VERSION);
+    snprintf(env->compiler_flags, sizeof(env->compiler_flags), "%s", BENCHMARK_COMPILER_FLAGS);
+    snprintf(env->git_commit, sizeof(env->git_commit), "%s", GIT_COMMIT_HASH);
+    snprintf(env->version, sizeof(env->version), "%s", VERSION);
+    return 1;
+}
+
+int benchmark_preflight(benchmark_env_t *env, benchmark_preflight_conf_t *conf)
+{
+    size_t problems = 0;
+    if (strcmp(env->governor, UNKNOWN) != 0 && strcmp(env->governor, "performance") != 0) {
+        lprintf(LOG_WARNING, "The cpu governor is %s, the clock speed will change during the runs\n", env->governor);
+        problems++;
+    }
+
+    double max_load = conf->max_load > 0 ? conf->max_load : DEFAULT_MAX_LOAD;
+    if (env->cpus > 0 && env->load_avg[0] / env->cpus > max_load) {
+        lprintf(LOG_WARNING, "The load average is %.2lf on %ld cores, other processes will add noise\n",
+                env->load_avg[0], env->cpus);
+        problems++;
+    }
+
+    if (env->aslr > 0) {
+        lprintf(LOG_WARNING, "ASLR is on, the memory layout and, the run times will change between processes\n");
+        problems++;
+    }
+
+    if (env->turbo == 1) {
+        lprintf(LOG_WARNING, "Turbo is on, the clock speed will depend on the temperature\n");
+        problems++;
+    }
+
+    if (problems > 0 && conf->strict) {
+        lprintf(LOG_ERROR, "%lu noisy settings, not running the benchmark\n", problems);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Used for settings that cannot be read, i.e: there is no cpufreq in a VM
+#define BENCHMARK_ENV_UNKNOWN -1
+
+/// The machine and, build that a profile was made on, results from different environments are not
+/// comparable. Strings that cannot be read are "unknown"
+typedef struct benchmark_env_t {
+    /// Whether this has been captured, a zeroed env has not
+    int captured;
+    /// The time that this was captured, seconds since the epoch
+    long timestamp;
+    char hostname[256];
+    char cpu_model[256];
+    /// The online cores
+    long cpus;
+    /// The cpufreq governor of cpu0
+    char governor[64];
+    /// 1 if turbo/boost is on, 0 if it is off, BENCHMARK_ENV_UNKNOWN if there is no knob
+    int turbo;
+    /// 1 if SMT (hyper threading) is active, 0 if it is not or, BENCHMARK_ENV_UNKNOWN
+    int smt;
+    /// /proc/sys/kernel/randomize_va_space, 0 is off or, BENCHMARK_ENV_UNKNOWN
+    int aslr;
+    /// uname sysname, release and, machine
+    char kernel[256];
+    /// 1, 5 and, 15 minute load averages
+    double load_avg[3];
+    /// The compiler and, flags that this library was built with
+    char compiler[128];
+    char compiler_flags[512];
+    /// GIT_COMMIT_HASH and, VERSION from CMakeLists.txt
+    char git_commit[64];
+    char version[128];
+} benchmark_env_t;
+
+/// Reads the environment from /proc, /sys and, the build. Settings that cannot be read are left
+/// as unknown so this only fails if env is NULL
+int capture_benchmark_env(benchmark_env_t *env);
+
+/// Checks the environment for settings that add noise before a benchmark is run
+typedef struct benchmark_preflight_conf_t {
+    int enabled;
+    /// Fail the benchmark instead of warning
+    int strict;
+    /// The highest 1 minute load average per online core that is not noisy, defaults to 0.25
+    double max_load;
+} benchmark_preflight_conf_t;
+
+/// Warns about each noisy setting in env (a governor other than "performance", a loaded machine,
+/// ASLR and, turbo), 0 if there are any and, the check is strict
+int benchmark_preflight(benchmark_env_t *env, benchmark_preflight_conf_t *conf);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,73 @@
+#include "./bench_registry.h"
+#include "./testing.h/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// The main for a suite of benchmarks, link the files that use BENCHMARK with this
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-l] [-f regex] [-r runs] [-o json|ndjson|csv|binary] [-p prefix]\n"
+            "  -l  list the benchmarks instead of running them\n"
+            "  -f  only use the benchmarks with names that match the regex\n"
+            "  -r  the number of runs of each benchmark, overrides the benchmark\n"
+            "  -o  the output type (default json)\n"
+            "  -p  put before each benchmark name to make its output file name\n", name);
+}
+
+static int parse_output_type(const char *str, benchmark_output_type_t *type)
+{
+    if (strcmp(str, "json") == 0) {
+        *type = OUTPUT_JSON;
+    } else if (strcmp(str, "ndjson") == 0) {
+        *type = OUTPUT_NDJSON;
+    } else if (strcmp(str, "csv") == 0) {
+        *type = OUTPUT_CSV;
+    } else if (strcmp(str, "binary") == 0) {
+        *type = OUTPUT_BINARY;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    benchmark_suite_conf_t conf;
+    init_benchmark_suite_conf(&conf);
+    int list = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lf:r:o:p:h")) != -1) {
+        switch (opt) {
+        case 'l':
+            list = 1;
+            break;
+        case 'f':
+            conf.filter = optarg;
+            break;
+        case 'r':
+            conf.runs = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            if (!parse_output_type(optarg, &conf.output_type)) {
+                lprintf(LOG_ERROR, "Unknown output type %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            conf.output_prefix = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (list) {
+        return list_benchmarks(stdout, &conf) ? 0 : 1;
+    }
+    return run_benchmark_suite(&conf) ? 0 : 1;
+}
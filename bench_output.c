@@ -3,11 +3,75 @@
 #include <stdio.h>
 #include <string.h>
 #include <jansson.h>
+#include <unistd.h>
+#include <inttypes.h>
 
 #define JSON_ASSERT(x) if (x != 0) {lprintf(LOG_ERROR, "JSON error\n"); return 0;}
 #define NULL_ASSERT(x) if (x == NULL) {lprintf(LOG_ERROR, "JSON error\n"); return 0;}
 
-static int save_benchmark_json_node(benchmark_profile_entry_t entry, json_t *arr)
+static json_t *save_benchmark_json_stats(benchmark_stats_t *stats)
+{
+    return json_pack("{sI sI sf sf sI sI sI sI sI}",
+                     "min", (json_int_t) stats->min,
+                     "max", (json_int_t) stats->max,
+                     "mean", stats->mean,
+                     "stddev", stats->stddev,
+                     "p50", (json_int_t) stats->p50,
+                     "p90", (json_int_t) stats->p90,
+                     "p99", (json_int_t) stats->p99,
+                     "p99.9", (json_int_t) stats->p999,
+                     "mad", (json_int_t) stats->mad);
+}
+
+/// Unavailable counters are null
+static json_t *save_benchmark_json_perf(benchmark_perf_t *perf)
+{
+    json_t *node = json_object();
+    if (node == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        json_t *val = (perf->available & (1 << i)) ? json_real(perf->counters[i]) : json_null();
+        if (val == NULL || json_object_set_new(node, perf_counter_name(i), val) != 0) {
+            json_decref(node);
+            return NULL;
+        }
+    }
+
+    json_t *ipc = json_real(perf->ipc);
+    if (ipc == NULL || json_object_set_new(node, "ipc", ipc) != 0) {
+        json_decref(node);
+        return NULL;
+    }
+    return node;
+}
+
+static json_t *save_benchmark_json_allocs(benchmark_alloc_t *allocs)
+{
+    json_t *size_classes_node = json_array();
+    if (size_classes_node == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < ALLOC_SIZE_CLASSES; i++) {
+        json_t *val = json_real(allocs->size_classes[i]);
+        if (val == NULL || json_array_append_new(size_classes_node, val) != 0) {
+            json_decref(size_classes_node);
+            return NULL;
+        }
+    }
+
+    return json_pack("{sI sf sf sf so}",
+                     "peak_bytes", (json_int_t) allocs->peak_bytes,
+                     "total_bytes", allocs->total_bytes,
+                     "allocations", allocs->allocations,
+                     "frees", allocs->frees,
+                     "size_classes", size_classes_node);
+}
+
+/// Creates the json object for an entry, NULL on failure
+static json_t *benchmark_entry_json(benchmark_profile_entry_t entry)
 {
     json_t *vector_node = json_array();
     NULL_ASSERT(vector_node);
@@ -25,16 +89,108 @@ static int save_benchmark_json_node(benchmark_profile_entry_t entry, json_t *arr
         JSON_ASSERT(json_array_append_new(run_outputs_node, val));
     }
 
-    json_t *node = json_pack("{so so si si si}",
+    json_t *run_times_node = json_array();
+    NULL_ASSERT(run_times_node);
+    for (size_t i = 0; i < entry.run_times_len; i++) {
+        json_t *val = json_integer(entry.run_times_ns[i]);
+        NULL_ASSERT(val);
+        JSON_ASSERT(json_array_append_new(run_times_node, val));
+    }
+
+    json_t *cpu_core_usage_node = json_array();
+    NULL_ASSERT(cpu_core_usage_node);
+    for (size_t i = 0; i < entry.cpu_cores; i++) {
+        json_t *val = json_integer(entry.cpu_core_usage_us[i]);
+        NULL_ASSERT(val);
+        JSON_ASSERT(json_array_append_new(cpu_core_usage_node, val));
+    }
+
+    json_t *stats_node = save_benchmark_json_stats(&entry.time_stats);
+    NULL_ASSERT(stats_node);
+    json_t *cold_stats_node = save_benchmark_json_stats(&entry.cold_time_stats);
+    NULL_ASSERT(cold_stats_node);
+
+    json_t *scaling_node = json_pack("{sI sI sf sf sf}",
+                                     "threads", (json_int_t) entry.scaling.threads,
+                                     "wall_time_ns", (json_int_t) entry.scaling.wall_time_ns,
+                                     "throughput", entry.scaling.throughput,
+                                     "speedup", entry.scaling.speedup,
+                                     "efficiency", entry.scaling.efficiency);
+    NULL_ASSERT(scaling_node);
+
+    json_t *perf_node = save_benchmark_json_perf(&entry.perf);
+    NULL_ASSERT(perf_node);
+    json_t *allocs_node = save_benchmark_json_allocs(&entry.allocs);
+    NULL_ASSERT(allocs_node);
+
+    json_t *node = json_pack("{so sI sb ss si sI sI so so so so so so si sI sf sI sf sf sf sf sf sf so si si sI sI sI sI so}",
                              "params", vector_node,
+                             "runs", (json_int_t) entry.runs,
+                             "converged", entry.converged,
+                             "status", benchmark_entry_status_name(entry.status),
+                             "signal", entry.signal,
+                             "warmup_runs", (json_int_t) entry.warmup_runs,
+                             "cold_runs", (json_int_t) entry.cold_runs,
+                             "cold_time_stats_ns", cold_stats_node,
+                             "scaling", scaling_node,
+                             "perf", perf_node,
+                             "allocs", allocs_node,
                              "run_outputs", run_outputs_node,
+                             "run_times_ns", run_times_node,
                              "cpu_time_us", entry.cpu_time_us,
+                             "cpu_time_ns", (json_int_t) entry.cpu_time_ns,
+                             "op_time_ns", entry.op_time_ns,
+                             "batch_iterations", (json_int_t) entry.batch_iterations,
+                             "batch_overhead_ns", entry.batch_overhead_ns,
+                             "bytes_per_op", entry.bytes_per_op,
+                             "items_per_op", entry.items_per_op,
+                             "gb_per_s", entry.gb_per_s,
+                             "items_per_s", entry.items_per_s,
+                             "ns_per_item", entry.ns_per_item,
+                             "time_stats_ns", stats_node,
                              "cpu_core_time_us", entry.cpu_core_time_us,
-                             "max_mem_usage", entry.max_mem_usage);
+                             "max_mem_usage", entry.max_mem_usage,
+                             "max_rss_usage", (json_int_t) entry.max_rss_usage,
+                             "max_pss_usage", (json_int_t) entry.max_pss_usage,
+                             "minor_faults", (json_int_t) entry.minor_faults,
+                             "major_faults", (json_int_t) entry.major_faults,
+                             "cpu_core_usage_us", cpu_core_usage_node);
+    return node;
+}
 
-    NULL_ASSERT(node);
-    JSON_ASSERT(json_array_append_new(arr, node));
-    return 1;
+/// Settings that could not be read are null
+static json_t *save_benchmark_json_env_setting(int value)
+{
+    return value == BENCHMARK_ENV_UNKNOWN ? json_null() : json_integer(value);
+}
+
+static json_t *save_benchmark_json_env(benchmark_env_t *env)
+{
+    return json_pack("{sI ss ss sI ss so so so ss s[fff] ss ss ss ss}",
+                     "timestamp", (json_int_t) env->timestamp,
+                     "hostname", env->hostname,
+                     "cpu_model", env->cpu_model,
+                     "cpus", (json_int_t) env->cpus,
+                     "governor", env->governor,
+                     "turbo", save_benchmark_json_env_setting(env->turbo),
+                     "smt", save_benchmark_json_env_setting(env->smt),
+                     "aslr", save_benchmark_json_env_setting(env->aslr),
+                     "kernel", env->kernel,
+                     "load_avg", env->load_avg[0], env->load_avg[1], env->load_avg[2],
+                     "compiler", env->compiler,
+                     "compiler_flags", env->compiler_flags,
+                     "git_commit", env->git_commit,
+                     "version", env->version);
+}
+
+/// Profiles that were not made by benchmark_program have their environment captured when saved
+static void benchmark_profile_env(benchmark_profile_t *profile, benchmark_env_t *env)
+{
+    if (profile->env.captured) {
+        *env = profile->env;
+    } else {
+        capture_benchmark_env(env);
+    }
 }
 
 /// Save when NO_PARAMS
@@ -44,14 +200,23 @@ static int __save_benchmark_json(benchmark_profile_t *profile, benchmark_output_
     NULL_ASSERT(arr);
 
     for (size_t i = 0; i < profile->len; i++) {
-        if (!save_benchmark_json_node(profile->entries[i], arr)) {
+        json_t *node = benchmark_entry_json(profile->entries[i]);
+        if (node == NULL || json_array_append_new(arr, node) != 0) {
             lprintf(LOG_ERROR, "Cannot create json, aborting\n");
             return 0;
         }
     }
 
-    JSON_ASSERT(json_dumpf(arr, f, JSON_COMPACT));
-    json_decref(arr);
+    benchmark_env_t env;
+    benchmark_profile_env(profile, &env);
+    json_t *env_node = save_benchmark_json_env(&env);
+    NULL_ASSERT(env_node);
+
+    // The entries are in an object with the environment
+    json_t *root = json_pack("{so so}", "env", env_node, "entries", arr);
+    NULL_ASSERT(root);
+    JSON_ASSERT(json_dumpf(root, f, JSON_COMPACT));
+    json_decref(root);
     return 1;
 }
 
@@ -70,6 +235,7 @@ int save_benchmark_json(benchmark_profile_t *profile, benchmark_output_conf_t *o
     switch (profile->conf.function_type) {
     case FUNC_PARAM:
     case FUNC_NO_PARAM:
+    case FUNC_PARALLEL:
         r = __save_benchmark_json(profile, output_conf, f);
         flag = 1;
         break;
@@ -84,37 +250,122 @@ int save_benchmark_json(benchmark_profile_t *profile, benchmark_output_conf_t *o
     return 0;
 }
 
-static void print_csv_headers(FILE *f, benchmark_profile_t *profile)
+/// The environment is written as comment lines of "# key,value" before the header
+static void print_csv_env(FILE *f, benchmark_env_t *env)
 {
-    for (size_t i = 0; i < profile->conf.param_conf.params_generator.dimensions; i++) {
+    fprintf(f, "# timestamp,%ld\n", env->timestamp);
+    fprintf(f, "# hostname,%s\n", env->hostname);
+    fprintf(f, "# cpu_model,%s\n", env->cpu_model);
+    fprintf(f, "# cpus,%ld\n", env->cpus);
+    fprintf(f, "# governor,%s\n", env->governor);
+    fprintf(f, "# turbo,%d\n", env->turbo);
+    fprintf(f, "# smt,%d\n", env->smt);
+    fprintf(f, "# aslr,%d\n", env->aslr);
+    fprintf(f, "# kernel,%s\n", env->kernel);
+    fprintf(f, "# load_avg,%lf,%lf,%lf\n", env->load_avg[0], env->load_avg[1], env->load_avg[2]);
+    fprintf(f, "# compiler,%s\n", env->compiler);
+    fprintf(f, "# compiler_flags,%s\n", env->compiler_flags);
+    fprintf(f, "# git_commit,%s\n", env->git_commit);
+    fprintf(f, "# version,%s\n", env->version);
+}
+
+/// The columns of the params and, per core usage depend on the entries
+static void print_csv_headers(FILE *f, size_t dimensions, size_t cores)
+{
+    for (size_t i = 0; i < dimensions; i++) {
         fprintf(f, "v%ld,", i);
     }
-    fprintf(f, "cpu_time_us,cpu_core_time_us,max_mem_usage,run_outputs\n");
+    fprintf(f, "cpu_time_us,cpu_time_ns,op_time_ns,batch_iterations,batch_overhead_ns,"
+            "bytes_per_op,items_per_op,gb_per_s,items_per_s,ns_per_item,min_ns,max_ns,mean_ns,stddev_ns,p50_ns,p90_ns,p99_ns,p99.9_ns,mad_ns,runs,converged,status,signal,"
+            "warmup_runs,cold_runs,cold_mean_ns,cold_p50_ns,cold_p99_ns,"
+            "threads,throughput,speedup,efficiency,"
+            "cpu_core_time_us,max_mem_usage,max_rss_usage,max_pss_usage,minor_faults,major_faults,");
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        fprintf(f, "%s,", perf_counter_name(i));
+    }
+    fprintf(f, "ipc,alloc_peak_bytes,alloc_bytes,allocs,frees,");
+
+    // The per core breakdown is only present when cpu profiling is enabled
+    for (size_t i = 0; i < cores; i++) {
+        fprintf(f, "core%lu_us,", i);
+    }
+    fprintf(f, "run_outputs\n");
 }
 
-static void print_csv_entry(FILE *f, benchmark_profile_t *profile, int i)
+static void print_csv_entry(FILE *f, benchmark_profile_entry_t *entry)
 {
-    fprintf(f, "%lu,%lu,%lu", profile->entries[i].cpu_time_us,
-            profile->entries[i].cpu_core_time_us,
-            profile->entries[i].max_mem_usage);
+    for (size_t j = 0; j < entry->params.dimensions; j++) {
+        fprintf(f, "%lf,", entry->params.values[j]);
+    }
+
+    benchmark_stats_t *stats = &entry->time_stats;
+    benchmark_stats_t *cold_stats = &entry->cold_time_stats;
+    benchmark_scaling_t *scaling = &entry->scaling;
+    fprintf(f, "%lu,%lu,%lf,%lu,%lf,%lf,%lf,%lf,%lf,%lf,%lu,%lu,%lf,%lf,%lu,%lu,%lu,%lu,%lu,%lu,%d,%s,%d,%lu,%lu,%lf,%lu,%lu,%lu,%lf,%lf,%lf,%lu,%lu,%lu,%lu,%lu,%lu",
+            entry->cpu_time_us,
+            entry->cpu_time_ns,
+            entry->op_time_ns, entry->batch_iterations, entry->batch_overhead_ns,
+            entry->bytes_per_op, entry->items_per_op, entry->gb_per_s, entry->items_per_s, entry->ns_per_item,
+            stats->min, stats->max, stats->mean, stats->stddev,
+            stats->p50, stats->p90, stats->p99, stats->p999, stats->mad,
+            entry->runs, entry->converged, benchmark_entry_status_name(entry->status), entry->signal,
+            entry->warmup_runs, entry->cold_runs,
+            cold_stats->mean, cold_stats->p50, cold_stats->p99,
+            scaling->threads, scaling->throughput, scaling->speedup, scaling->efficiency,
+            entry->cpu_core_time_us,
+            entry->max_mem_usage,
+            entry->max_rss_usage, entry->max_pss_usage,
+            entry->minor_faults, entry->major_faults);
+
+    // Unavailable counters are left blank
+    benchmark_perf_t *perf = &entry->perf;
+    for (size_t j = 0; j < PERF_COUNTERS; j++) {
+        if (perf->available & (1 << j)) {
+            fprintf(f, ",%lf", perf->counters[j]);
+        } else {
+            fprintf(f, ",");
+        }
+    }
+    fprintf(f, ",%lf", perf->ipc);
+
+    benchmark_alloc_t *allocs = &entry->allocs;
+    fprintf(f, ",%lu,%lf,%lf,%lf", allocs->peak_bytes, allocs->total_bytes, allocs->allocations, allocs->frees);
+
+    for (size_t j = 0; j < entry->cpu_cores; j++) {
+        fprintf(f, ",%lu", entry->cpu_core_usage_us[j]);
+    }
 
-    for (size_t j = 0; j < profile->entries[i].run_outputs_len; j++) {
-        fprintf(f, ",%d", profile->entries[i].run_outputs[j]);
+    for (size_t j = 0; j < entry->run_outputs_len; j++) {
+        fprintf(f, ",%d", entry->run_outputs[j]);
     }
     fprintf(f, "\n");
     fflush(f);
 }
 
+/// The params of the first entry are used for the header, FUNC_PARALLEL has the thread count as a
+/// param without a params generator
+static void print_csv_profile_headers(FILE *f, benchmark_profile_t *profile)
+{
+    benchmark_env_t env;
+    benchmark_profile_env(profile, &env);
+    print_csv_env(f, &env);
+
+    size_t dimensions = profile->conf.param_conf.params_generator.dimensions;
+    size_t cores = 0;
+    if (profile->len > 0) {
+        dimensions = profile->entries[0].params.dimensions;
+        cores = profile->entries[0].cpu_cores;
+    }
+    print_csv_headers(f, dimensions, cores);
+}
+
 /// Save when PARAMS
 static int save_benchmark_csv_p(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf, FILE *f)
 {
-    print_csv_headers(f, profile);
+    print_csv_profile_headers(f, profile);
 
     for (size_t i = 0; i < profile->len; i++) {
-        for (size_t j = 0; j < profile->entries[i].params.dimensions; j++) {
-            fprintf(f, "%lf,", profile->entries[i].params.values[j]);
-        }
-        print_csv_entry(f, profile, i);
+        print_csv_entry(f, &profile->entries[i]);
     }
     return 1;
 }
@@ -122,10 +373,10 @@ static int save_benchmark_csv_p(benchmark_profile_t *profile, benchmark_output_c
 /// Save when NO_PARAMS
 static int save_benchmark_csv_np(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf, FILE *f)
 {
-    print_csv_headers(f, profile);
+    print_csv_profile_headers(f, profile);
 
     for (size_t i = 0; i < profile->len; i++) {
-        print_csv_entry(f, profile, i);
+        print_csv_entry(f, &profile->entries[i]);
     }
     return 1;
 }
@@ -144,6 +395,7 @@ int save_benchmark_csv(benchmark_profile_t *profile, benchmark_output_conf_t *ou
     int r, flag = 0;
     switch (profile->conf.function_type) {
     case FUNC_PARAM:
+    case FUNC_PARALLEL:
         r = save_benchmark_csv_p(profile, output_conf, f);
         flag = 1;
         break;
@@ -161,3 +413,222 @@ int save_benchmark_csv(benchmark_profile_t *profile, benchmark_output_conf_t *ou
     lprintf(LOG_ERROR, "Canot find output method for function type\n");
     return 0;
 }
+
+/// The extension of an output type that can be streamed, NULL if it cannot be
+static const char *stream_extension(benchmark_output_type_t type)
+{
+    switch (type) {
+    case OUTPUT_CSV:
+        return "csv";
+    case OUTPUT_NDJSON:
+        return "ndjson";
+    default:
+        return NULL;
+    }
+}
+
+int open_benchmark_sink(benchmark_sink_t *sink, benchmark_output_conf_t *output_conf,
+                        benchmark_checkpoint_t *resume)
+{
+    const char *ext = stream_extension(output_conf->output_type);
+    if (ext == NULL) {
+        lprintf(LOG_ERROR, "Only CSV and, NDJSON outputs can be streamed\n");
+        return 0;
+    }
+
+    char name[255];
+    snprintf(name, sizeof(name), "%s.bench.%s", output_conf->output_file_prefix, ext);
+    sink->f = fopen(name, resume != NULL ? "r+" : "w");
+    if (sink->f == NULL) {
+        lprintf(LOG_ERROR, "Cannot open output file %s\n", name);
+        return 0;
+    }
+
+    sink->type = output_conf->output_type;
+    sink->entries = 0;
+    sink->streamed = 0;
+    sink->env = NULL;
+    if (resume != NULL) {
+        if (ftruncate(fileno(sink->f), resume->output_offset) != 0 || fseek(sink->f, 0, SEEK_END) != 0) {
+            lprintf(LOG_ERROR, "Cannot resume output file %s\n", name);
+            fclose(sink->f);
+            return 0;
+        }
+        sink->entries = resume->entries;
+    }
+    return 1;
+}
+
+int write_benchmark_sink(benchmark_sink_t *sink, benchmark_profile_entry_t *entry)
+{
+    if (sink->type == OUTPUT_CSV) {
+        // The header needs the number of params and, cores, which are only known from an entry
+        if (sink->entries == 0) {
+            if (sink->env != NULL) {
+                print_csv_env(sink->f, sink->env);
+            }
+            print_csv_headers(sink->f, entry->params.dimensions, entry->cpu_cores);
+        }
+        print_csv_entry(sink->f, entry);
+    } else {
+        json_t *node = benchmark_entry_json(*entry);
+        NULL_ASSERT(node);
+        int r = json_dumpf(node, sink->f, JSON_COMPACT);
+        json_decref(node);
+        JSON_ASSERT(r);
+        fprintf(sink->f, "\n");
+        fflush(sink->f);
+    }
+
+    if (ferror(sink->f)) {
+        lprintf(LOG_ERROR, "Cannot write to output file\n");
+        return 0;
+    }
+    sink->entries++;
+    sink->streamed++;
+    return 1;
+}
+
+void close_benchmark_sink(benchmark_sink_t *sink)
+{
+    if (sink->f != NULL) {
+        fclose(sink->f);
+        sink->f = NULL;
+    }
+}
+
+int save_benchmark_ndjson(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf)
+{
+    benchmark_sink_t sink;
+    if (!open_benchmark_sink(&sink, output_conf, NULL)) {
+        return 0;
+    }
+
+    int ret = 1;
+    for (size_t i = 0; i < profile->len && ret; i++) {
+        ret = write_benchmark_sink(&sink, &profile->entries[i]);
+    }
+    close_benchmark_sink(&sink);
+    return ret;
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+#define FNV_FIELD(hash, field) hash = fnv1a(hash, &(field), sizeof(field))
+
+uint64_t benchmark_conf_fingerprint(benchmark_conf_t *conf)
+{
+    uint64_t hash = FNV_OFFSET;
+    FNV_FIELD(hash, conf->function_type);
+    FNV_FIELD(hash, conf->runs_to_average);
+    FNV_FIELD(hash, conf->adaptive_conf.enabled);
+    FNV_FIELD(hash, conf->monitor_func_output);
+    FNV_FIELD(hash, conf->max_run_times);
+    if (conf->stream_conf.output != NULL) {
+        FNV_FIELD(hash, conf->stream_conf.output->output_type);
+    }
+
+    // The settings that change what is measured, the addresses of the callbacks change between
+    // processes so only whether they are set is hashed
+    FNV_FIELD(hash, conf->batch_conf.enabled);
+    FNV_FIELD(hash, conf->batch_conf.target_ns);
+    FNV_FIELD(hash, conf->batch_conf.iterations);
+    int fixtures = (conf->fixture_conf.func != NULL) | (conf->fixture_conf.setup != NULL) << 1
+                   | (conf->fixture_conf.teardown != NULL) << 2 | (conf->fixture_conf.run_setup != NULL) << 3
+                   | (conf->fixture_conf.run_teardown != NULL) << 4;
+    FNV_FIELD(hash, fixtures);
+    FNV_FIELD(hash, conf->isolation_conf.enabled);
+    FNV_FIELD(hash, conf->isolation_conf.timeout_ms);
+    FNV_FIELD(hash, conf->isolation_conf.max_memory);
+    FNV_FIELD(hash, conf->isolation_conf.max_cpu_s);
+
+    // The fields are hashed one at a time as there is padding and, internal state in the structs
+    multi_dimensional_range_t *generator = &conf->param_conf.params_generator;
+    FNV_FIELD(hash, generator->dimensions);
+    FNV_FIELD(hash, generator->sampling);
+    FNV_FIELD(hash, generator->samples);
+    FNV_FIELD(hash, generator->seed);
+    for (size_t i = 0; i < generator->dimensions; i++) {
+        // Only the fields that the kind uses are hashed
+        range_t *range = &generator->ranges[i];
+        range_kind_t kind = range->kind;
+        FNV_FIELD(hash, kind);
+        FNV_FIELD(hash, range->start);
+        FNV_FIELD(hash, range->end);
+        FNV_FIELD(hash, range->step);
+        if (kind == RANGE_LOG || kind == RANGE_LIST) {
+            FNV_FIELD(hash, range->count);
+        }
+        if (kind == RANGE_LIST) {
+            hash = fnv1a(hash, range->values, sizeof(*range->values) * range->count);
+        }
+    }
+    return hash;
+}
+
+/// The checkpoint is named after the output so that a CSV and, an NDJSON sweep with the same prefix
+/// do not share it
+static void checkpoint_name(benchmark_output_conf_t *output_conf, char *name, size_t len)
+{
+    const char *ext = stream_extension(output_conf->output_type);
+    snprintf(name, len, "%s.bench.%s.ckpt", output_conf->output_file_prefix, ext != NULL ? ext : "out");
+}
+
+int read_benchmark_checkpoint(benchmark_output_conf_t *output_conf, benchmark_checkpoint_t *ckpt)
+{
+    char name[255];
+    checkpoint_name(output_conf, name, sizeof(name));
+    FILE *f = fopen(name, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    int r = fscanf(f, "fingerprint %" SCNx64 "\nnext_index %zu\nentries %zu\noutput_offset %ld\n",
+                   &ckpt->fingerprint, &ckpt->next_index, &ckpt->entries, &ckpt->output_offset);
+    fclose(f);
+    if (r != 4) {
+        lprintf(LOG_WARNING, "Ignoring invalid checkpoint %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+int write_benchmark_checkpoint(benchmark_output_conf_t *output_conf, benchmark_checkpoint_t *ckpt)
+{
+    char name[255], tmp_name[260];
+    checkpoint_name(output_conf, name, sizeof(name));
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+
+    FILE *f = fopen(tmp_name, "w");
+    if (f == NULL) {
+        lprintf(LOG_ERROR, "Cannot open checkpoint %s\n", tmp_name);
+        return 0;
+    }
+
+    fprintf(f, "fingerprint %" PRIx64 "\nnext_index %zu\nentries %zu\noutput_offset %ld\n",
+            ckpt->fingerprint, ckpt->next_index, ckpt->entries, ckpt->output_offset);
+    int failed = ferror(f);
+    failed |= fclose(f) != 0;
+    if (failed || rename(tmp_name, name) != 0) {
+        lprintf(LOG_ERROR, "Cannot write checkpoint %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+void remove_benchmark_checkpoint(benchmark_output_conf_t *output_conf)
+{
+    char name[255];
+    checkpoint_name(output_conf, name, sizeof(name));
+    remove(name);
+}
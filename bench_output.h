@@ -1,6 +1,49 @@
 #pragma once
 #include "./bench.h"
+#include <stdio.h>
 
 int save_benchmark_json(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf);
 int save_benchmark_csv(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf);
+int save_benchmark_ndjson(benchmark_profile_t *profile, benchmark_output_conf_t *output_conf);
+
+/// An output file that entries are appended to as they finish, each entry is flushed
+typedef struct benchmark_sink_t {
+    FILE *f;
+    benchmark_output_type_t type;
+    /// The number of entries that are in the output, this includes the ones from a checkpoint
+    size_t entries;
+    /// The number of entries that have been written by this sink
+    size_t streamed;
+    /// Written before the CSV header when it is not NULL
+    benchmark_env_t *env;
+} benchmark_sink_t;
+
+/// Where a sweep that was stopped got to, see benchmark_stream_conf_t::checkpoint
+typedef struct benchmark_checkpoint_t {
+    /// See benchmark_conf_fingerprint, a checkpoint is only used for the same config
+    uint64_t fingerprint;
+    /// The index in the params generator of the next entry to run
+    size_t next_index;
+    /// The number of entries that are in the output
+    size_t entries;
+    /// The length of the output after the last entry, anything after this is from an entry
+    /// that was being written when the sweep was stopped
+    long output_offset;
+} benchmark_checkpoint_t;
+
+/// A hash of the parts of a config that change which points are run and, how
+uint64_t benchmark_conf_fingerprint(benchmark_conf_t *conf);
+/// Reads the checkpoint of an output, 0 if there is not one
+int read_benchmark_checkpoint(benchmark_output_conf_t *output_conf, benchmark_checkpoint_t *ckpt);
+/// Replaces the checkpoint of an output, the file is renamed into place so it is never partial
+int write_benchmark_checkpoint(benchmark_output_conf_t *output_conf, benchmark_checkpoint_t *ckpt);
+void remove_benchmark_checkpoint(benchmark_output_conf_t *output_conf);
+
+/// Opens the CSV or, NDJSON file of an output, 0 on failure. If resume is not NULL the file is
+/// cut to the end of the last entry in the checkpoint and, appended to.
+int open_benchmark_sink(benchmark_sink_t *sink, benchmark_output_conf_t *output_conf,
+                        benchmark_checkpoint_t *resume);
+/// Appends an entry to the file and, flushes it, 0 on failure
+int write_benchmark_sink(benchmark_sink_t *sink, benchmark_profile_entry_t *entry);
+void close_benchmark_sink(benchmark_sink_t *sink);
 
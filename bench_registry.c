@@ -0,0 +1,137 @@
+#include "./bench_registry.h"
+#include "./testing.h/logger.h"
+#include <string.h>
+#include <regex.h>
+
+// Constructors run before main on a single thread so the registry is not locked
+static benchmark_registration_t *registry_head = NULL;
+static benchmark_registration_t *registry_tail = NULL;
+
+void register_benchmark(benchmark_registration_t *registration)
+{
+    for (benchmark_registration_t *reg = registry_head; reg != NULL; reg = reg->next) {
+        if (strcmp(reg->name, registration->name) == 0) {
+            lprintf(LOG_WARNING, "Benchmark %s is registered more than once\n", registration->name);
+            break;
+        }
+    }
+
+    registration->next = NULL;
+    if (registry_tail == NULL) {
+        registry_head = registration;
+    } else {
+        registry_tail->next = registration;
+    }
+    registry_tail = registration;
+}
+
+benchmark_registration_t *registered_benchmarks()
+{
+    return registry_head;
+}
+
+void init_benchmark_suite_conf(benchmark_suite_conf_t *conf)
+{
+    conf->filter = NULL;
+    conf->runs = 0;
+    conf->output_type = OUTPUT_JSON;
+    conf->output_prefix = "";
+}
+
+static int init_filter(regex_t *regex, benchmark_suite_conf_t *conf)
+{
+    if (conf->filter == NULL) {
+        return 1;
+    }
+
+    int r = regcomp(regex, conf->filter, REG_EXTENDED | REG_NOSUB);
+    if (r != 0) {
+        char error[BUFFER_LENGTH];
+        regerror(r, regex, error, sizeof(error));
+        lprintf(LOG_ERROR, "Invalid filter %s: %s\n", conf->filter, error);
+        return 0;
+    }
+    return 1;
+}
+
+static int filter_matches(regex_t *regex, benchmark_suite_conf_t *conf, const char *name)
+{
+    return conf->filter == NULL || regexec(regex, name, 0, NULL, 0) == 0;
+}
+
+static void free_filter(regex_t *regex, benchmark_suite_conf_t *conf)
+{
+    if (conf->filter != NULL) {
+        regfree(regex);
+    }
+}
+
+int list_benchmarks(FILE *f, benchmark_suite_conf_t *conf)
+{
+    regex_t regex;
+    if (!init_filter(&regex, conf)) {
+        return 0;
+    }
+
+    for (benchmark_registration_t *reg = registry_head; reg != NULL; reg = reg->next) {
+        if (filter_matches(&regex, conf, reg->name)) {
+            fprintf(f, "%s\n", reg->name);
+        }
+    }
+
+    free_filter(&regex, conf);
+    return 1;
+}
+
+static int run_registered_benchmark(benchmark_registration_t *reg, benchmark_suite_conf_t *conf)
+{
+    benchmark_conf_t bench_conf;
+    memset(&bench_conf, 0, sizeof(bench_conf));
+    reg->init_conf(&bench_conf);
+    if (conf->runs > 0) {
+        bench_conf.runs_to_average = conf->runs;
+    }
+
+    char prefix[255];
+    snprintf(prefix, sizeof(prefix), "%s%s", conf->output_prefix, reg->name);
+    benchmark_output_conf_t output_conf;
+    int ret = init_benchmark_output_conf(&output_conf, conf->output_type, prefix);
+
+    benchmark_profile_t profile;
+    if (ret) {
+        lprintf(LOG_INFO, "Running %s\n", reg->name);
+        ret = benchmark_program(&bench_conf, &profile);
+        ret = ret && save_benchmark(&profile, &output_conf);
+        free_benchmark_profile(&profile);
+        free_benchmark_output_conf(&output_conf);
+    }
+
+    free_multi_dimensional_range(&bench_conf.param_conf.params_generator);
+    if (!ret) {
+        lprintf(LOG_ERROR, "Benchmark %s failed\n", reg->name);
+    }
+    return ret;
+}
+
+int run_benchmark_suite(benchmark_suite_conf_t *conf)
+{
+    regex_t regex;
+    if (!init_filter(&regex, conf)) {
+        return 0;
+    }
+
+    int ret = 1;
+    size_t ran = 0;
+    for (benchmark_registration_t *reg = registry_head; reg != NULL; reg = reg->next) {
+        if (filter_matches(&regex, conf, reg->name)) {
+            ret &= run_registered_benchmark(reg, conf);
+            ran++;
+        }
+    }
+
+    free_filter(&regex, conf);
+    if (ran == 0) {
+        lprintf(LOG_WARNING, "No benchmarks match the filter\n");
+    }
+    return ret;
+}
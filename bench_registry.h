@@ -0,0 +1,62 @@
+#pragma once
+#include "./bench.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A benchmark that was registered with BENCHMARK
+typedef struct benchmark_registration_t {
+    const char *name;
+    /// Sets up a config that was zeroed, the params generator is freed by the suite after the run
+    void (*init_conf)(benchmark_conf_t *conf);
+    struct benchmark_registration_t *next;
+} benchmark_registration_t;
+
+/// Adds a benchmark to the end of the registry, this is called before main by BENCHMARK
+void register_benchmark(benchmark_registration_t *registration);
+
+/// The first registered benchmark, the rest are in the order they were registered
+benchmark_registration_t *registered_benchmarks();
+
+/// Registers a benchmark called name, the body sets up benchmark_conf_t *conf:
+///
+/// BENCHMARK(hash_short_keys) {
+///     conf->function_type = FUNC_NO_PARAM;
+///     conf->np_func = &hash_short_keys;
+///     conf->runs_to_average = 10000;
+/// }
+#define BENCHMARK(name) \
+    static void name##_init_conf(benchmark_conf_t *conf); \
+    static benchmark_registration_t name##_registration = {#name, &name##_init_conf, NULL}; \
+    __attribute__((constructor)) static void name##_register() \
+    { \
+        register_benchmark(&name##_registration); \
+    } \
+    static void name##_init_conf(benchmark_conf_t *conf)
+
+/// Settings for running the registered benchmarks
+typedef struct benchmark_suite_conf_t {
+    /// A POSIX extended regex that the names have to match, NULL for all benchmarks
+    const char *filter;
+    /// Overrides benchmark_conf_t::runs_to_average when it is not 0
+    size_t runs;
+    benchmark_output_type_t output_type;
+    /// Put before each benchmark name to make its output prefix, i.e: "results/"
+    const char *output_prefix;
+} benchmark_suite_conf_t;
+
+/// Sets the defaults, every benchmark is run and, saved as JSON in the working directory
+void init_benchmark_suite_conf(benchmark_suite_conf_t *conf);
+
+/// Prints the names of the registered benchmarks that match the filter, 0 if the filter is invalid
+int list_benchmarks(FILE *f, benchmark_suite_conf_t *conf);
+
+/// Runs and, saves each registered benchmark that matches the filter, a benchmark that fails
+/// does not stop the others. 0 if any failed or, the filter is invalid
+int run_benchmark_suite(benchmark_suite_conf_t *conf);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,225 @@
+#include "./histogram.h"
+#include "./testing.h/logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HISTOGRAM_BUCKETS (HISTOGRAM_ROWS * HISTOGRAM_SUB_BUCKETS)
+
+/// Gets the row and, sub bucket that a value is stored in
+static void histogram_index(uint64_t value, size_t *row, size_t *sub)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        *row = 0;
+        *sub = value;
+        return;
+    }
+
+    // Row r >= 1 holds [2 ^ (bits + r - 1), 2 ^ (bits + r)) in buckets that are 2 ^ (r - 1) wide
+    size_t msb = 63 - __builtin_clzll(value);
+    *row = msb - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    *sub = (value >> (*row - 1)) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/// The value in the middle of a bucket, buckets are indexed from 0 to HISTOGRAM_BUCKETS
+static uint64_t histogram_bucket_value(size_t bucket)
+{
+    size_t row = bucket / HISTOGRAM_SUB_BUCKETS;
+    size_t sub = bucket % HISTOGRAM_SUB_BUCKETS;
+    if (row == 0) {
+        return sub;
+    }
+
+    uint64_t width = (uint64_t) 1 << (row - 1);
+    return ((HISTOGRAM_SUB_BUCKETS + sub) << (row - 1)) + width / 2;
+}
+
+static uint64_t histogram_bucket_count(histogram_t *hist, size_t bucket)
+{
+    uint64_t *row = hist->rows[bucket / HISTOGRAM_SUB_BUCKETS];
+    if (row == NULL) {
+        return 0;
+    }
+    return row[bucket % HISTOGRAM_SUB_BUCKETS];
+}
+
+/// Clamps a bucket value to the exact range that was recorded
+static uint64_t histogram_clamp(histogram_t *hist, uint64_t value)
+{
+    if (value < hist->min) {
+        return hist->min;
+    }
+    if (value > hist->max) {
+        return hist->max;
+    }
+    return value;
+}
+
+void init_histogram(histogram_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+void free_histogram(histogram_t *hist)
+{
+    if (hist == NULL) return;
+    for (size_t i = 0; i < HISTOGRAM_ROWS; i++) {
+        if (hist->rows[i] != NULL) {
+            free(hist->rows[i]);
+        }
+    }
+    init_histogram(hist);
+}
+
+void reset_histogram(histogram_t *hist)
+{
+    for (size_t i = 0; i < HISTOGRAM_ROWS; i++) {
+        if (hist->rows[i] != NULL) {
+            memset(hist->rows[i], 0, sizeof(*hist->rows[i]) * HISTOGRAM_SUB_BUCKETS);
+        }
+    }
+    hist->count = 0;
+    hist->min = hist->max = 0;
+    hist->mean = hist->m2 = 0;
+}
+
+int histogram_record(histogram_t *hist, uint64_t value)
+{
+    size_t row, sub;
+    histogram_index(value, &row, &sub);
+
+    if (hist->rows[row] == NULL) {
+        hist->rows[row] = calloc(HISTOGRAM_SUB_BUCKETS, sizeof(*hist->rows[row]));
+        if (hist->rows[row] == NULL) {
+            lprintf(LOG_ERROR, "Cannot allocate histogram row\n");
+            return 0;
+        }
+    }
+    hist->rows[row][sub]++;
+
+    if (hist->count == 0 || value < hist->min) {
+        hist->min = value;
+    }
+    if (hist->count == 0 || value > hist->max) {
+        hist->max = value;
+    }
+
+    hist->count++;
+    double delta = value - hist->mean;
+    hist->mean += delta / hist->count;
+    hist->m2 += delta * (value - hist->mean);
+    return 1;
+}
+
+int histogram_merge(histogram_t *dst, histogram_t *src)
+{
+    if (src->count == 0) {
+        return 1;
+    }
+
+    for (size_t row = 0; row < HISTOGRAM_ROWS; row++) {
+        if (src->rows[row] == NULL) {
+            continue;
+        }
+        if (dst->rows[row] == NULL) {
+            dst->rows[row] = calloc(HISTOGRAM_SUB_BUCKETS, sizeof(*dst->rows[row]));
+            if (dst->rows[row] == NULL) {
+                lprintf(LOG_ERROR, "Cannot allocate histogram row\n");
+                return 0;
+            }
+        }
+        for (size_t sub = 0; sub < HISTOGRAM_SUB_BUCKETS; sub++) {
+            dst->rows[row][sub] += src->rows[row][sub];
+        }
+    }
+
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (dst->count == 0 || src->max > dst->max) {
+        dst->max = src->max;
+    }
+
+    // Chan et al's method for combining the variance of two sets
+    size_t count = dst->count + src->count;
+    double delta = src->mean - dst->mean;
+    dst->mean += delta * src->count / count;
+    dst->m2 += src->m2 + delta * delta * ((double) dst->count * src->count / count);
+    dst->count = count;
+    return 1;
+}
+
+uint64_t histogram_percentile(histogram_t *hist, double percentile)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    size_t rank = (size_t) ceil(percentile / 100.0 * hist->count);
+    // The extremes are known exactly
+    if (rank <= 1) {
+        return hist->min;
+    }
+    if (rank >= hist->count) {
+        return hist->max;
+    }
+
+    size_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram_bucket_count(hist, i);
+        if (seen >= rank) {
+            return histogram_clamp(hist, histogram_bucket_value(i));
+        }
+    }
+    return hist->max;
+}
+
+double histogram_stddev(histogram_t *hist)
+{
+    if (hist->count < 2) {
+        return 0;
+    }
+    return sqrt(hist->m2 / (hist->count - 1));
+}
+
+uint64_t histogram_mad(histogram_t *hist)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t median = histogram_percentile(hist, 50);
+    size_t median_bucket, row, sub;
+    histogram_index(median, &row, &sub);
+    median_bucket = row * HISTOGRAM_SUB_BUCKETS + sub;
+
+    // Buckets get further from the median in both directions, so walk outwards from it
+    // taking the closer bucket each time until half of the values have been seen
+    size_t rank = (hist->count + 1) / 2;
+    size_t seen = histogram_bucket_count(hist, median_bucket);
+    long lower = (long) median_bucket - 1;
+    size_t upper = median_bucket + 1;
+    uint64_t deviation = 0;
+
+    while (seen < rank) {
+        uint64_t lower_dev = UINT64_MAX, upper_dev = UINT64_MAX;
+        if (lower >= 0) {
+            lower_dev = median - histogram_clamp(hist, histogram_bucket_value(lower));
+        }
+        if (upper < HISTOGRAM_BUCKETS) {
+            upper_dev = histogram_clamp(hist, histogram_bucket_value(upper)) - median;
+        }
+
+        if (lower_dev <= upper_dev) {
+            seen += histogram_bucket_count(hist, lower);
+            deviation = lower_dev;
+            lower--;
+        } else {
+            seen += histogram_bucket_count(hist, upper);
+            deviation = upper_dev;
+            upper++;
+        }
+    }
+
+    return deviation;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Each power of two is split into this many linear buckets, so the error of a
+/// value read from the histogram is at most 1 / (2 ^ HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+/// Row 0 holds the values that fit exactly, then there is one row per power of two
+#define HISTOGRAM_ROWS (64 - HISTOGRAM_SUB_BUCKET_BITS + 1)
+
+/// A log-linear (HDR style) histogram of uint64_t values, this has bounded memory
+/// no matter how many values are recorded. The mean, min, max and, variance are exact.
+typedef struct histogram_t {
+    /// Rows are only allocated once a value is recorded in them
+    uint64_t *rows[HISTOGRAM_ROWS];
+    size_t count;
+    uint64_t min;
+    uint64_t max;
+    /// Running mean and, sum of squares of differences from the mean (Welford's method)
+    double mean;
+    double m2;
+} histogram_t;
+
+/// Inits an empty histogram
+void init_histogram(histogram_t *hist);
+
+/// Frees the rows of a histogram
+void free_histogram(histogram_t *hist);
+
+/// Empties a histogram, keeping its rows allocated
+void reset_histogram(histogram_t *hist);
+
+/// Records a value, 0 on failure
+int histogram_record(histogram_t *hist, uint64_t value);
+
+/// Adds all of the values in src to dst, 0 on failure
+int histogram_merge(histogram_t *dst, histogram_t *src);
+
+/// Gets the value at a percentile (0 - 100), 0 if the histogram is empty
+uint64_t histogram_percentile(histogram_t *hist, double percentile);
+
+/// The sample standard deviation of the recorded values
+double histogram_stddev(histogram_t *hist);
+
+/// The median absolute deviation of the recorded values
+uint64_t histogram_mad(histogram_t *hist);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,7 +1,20 @@
+#define _GNU_SOURCE
 #include "./mem_profiler.h"
+#include "./alloc_tracker.h"
 #include "./testing.h/logger.h"
 #include <malloc.h>
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+/// Profiler threads are named with this prefix so that the cpu profiler does not count them
+#define PROFILER_THREAD_PREFIX "bench-"
 
 /// A function to make sure that all profiling actions use the same method
 static size_t get_malloc_info()
@@ -10,26 +23,108 @@ static size_t get_malloc_info()
     return info.uordblks;
 }
 
+/// Reads a whole /proc file into buf with pread so that no memory is allocated, 0 on failure
+static int read_proc_fd(int fd, char *buf, size_t len)
+{
+    ssize_t r = pread(fd, buf, len - 1, 0);
+    if (r <= 0) {
+        return 0;
+    }
+    buf[r] = 0;
+    return 1;
+}
+
+/// The resident set size in bytes, 0 on failure
+static size_t get_rss(memory_profiler_t *mpt)
+{
+    char buf[256];
+    if (mpt->statm_fd < 0 || !read_proc_fd(mpt->statm_fd, buf, sizeof(buf))) {
+        return 0;
+    }
+
+    // size resident shared text lib data dt, in pages
+    char *end;
+    strtoull(buf, &end, 10);
+    return strtoull(end, NULL, 10) * sysconf(_SC_PAGESIZE);
+}
+
+/// The proportional set size in bytes, 0 on failure
+static size_t get_pss(memory_profiler_t *mpt)
+{
+    char buf[4096];
+    if (mpt->smaps_fd < 0 || !read_proc_fd(mpt->smaps_fd, buf, sizeof(buf))) {
+        return 0;
+    }
+
+    char *line = strstr(buf, "\nPss:");
+    if (line == NULL) {
+        return 0;
+    }
+    return strtoull(line + strlen("\nPss:"), NULL, 10) * 1024;
+}
+
+/// A peak is (epoch << PEAK_EPOCH_SHIFT) | bytes, the bytes are capped at 256 TiB
+#define PEAK_EPOCH_SHIFT 48
+#define PEAK_VALUE_MASK (((uint64_t) 1 << PEAK_EPOCH_SHIFT) - 1)
+
+static uint64_t peak_word(unsigned int epoch, size_t val)
+{
+    uint64_t bytes = val < PEAK_VALUE_MASK ? val : PEAK_VALUE_MASK;
+    return ((uint64_t) epoch << PEAK_EPOCH_SHIFT) | bytes;
+}
+
+/// Raises a peak if it is still for epoch, the epoch and, the value are compared and, swapped
+/// together so a calibration between the check and, the store cannot be missed
+static void atomic_peak_max(atomic_uint_least64_t *peak, unsigned int epoch, size_t val)
+{
+    uint64_t want = peak_word(epoch, val);
+    uint64_t cur = atomic_load_explicit(peak, memory_order_relaxed);
+    while (cur >> PEAK_EPOCH_SHIFT == want >> PEAK_EPOCH_SHIFT && want > cur
+            && !atomic_compare_exchange_weak_explicit(peak, &cur, want, memory_order_relaxed,
+                    memory_order_relaxed));
+}
+
+static size_t get_heap(memory_profiler_t *mpt)
+{
+    return mpt->skip_heap ? 0 : get_malloc_info();
+}
+
+/// Samples the memory usage and, raises the peaks, samples that were taken before a calibration are dropped
+static void sample_memory(memory_profiler_t *mpt)
+{
+    unsigned int epoch = atomic_load_explicit(&mpt->epoch, memory_order_acquire);
+    size_t heap = get_heap(mpt);
+    size_t rss = mpt->sample_rss ? get_rss(mpt) : 0;
+    size_t pss = mpt->sample_pss ? get_pss(mpt) : 0;
+
+    atomic_peak_max(&mpt->max_mem_usage, epoch, heap);
+    atomic_peak_max(&mpt->max_rss, epoch, rss);
+    atomic_peak_max(&mpt->max_pss, epoch, pss);
+}
+
 static void *memory_profiler_thread(void *mpt_raw)
 {
     memory_profiler_t *mpt = (memory_profiler_t *) mpt_raw;
-    pthread_mutex_unlock(&mpt->lock);
+    pthread_setname_np(pthread_self(), PROFILER_THREAD_PREFIX "mem-prof");
+    alloc_tracker_ignore_thread(1);
 
-    int flag = 1;
-    while (flag) {
-        pthread_mutex_lock(&mpt->lock);
-        flag = mpt->running;
+    // Polls are on an absolute schedule so that the time taken to sample does not add drift
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (atomic_load_explicit(&mpt->running, memory_order_relaxed)) {
+        sample_memory(mpt);
 
-        size_t usage = get_malloc_info();
-        if (usage > mpt->max_mem_usage) {
-            mpt->max_mem_usage = usage;
-        }
-        long period = mpt->poll_time;
-        pthread_mutex_unlock(&mpt->lock);
+        next.tv_nsec += (long) (mpt->poll_time % 1000) * 1000 * 1000;
+        next.tv_sec += mpt->poll_time / 1000 + next.tv_nsec / (1000 * 1000 * 1000);
+        next.tv_nsec %= 1000 * 1000 * 1000;
 
-        if (flag) {
-            usleep(period);
+        // When a sample overruns the period the schedule restarts from now instead of catching up
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+            next = now;
         }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
     }
 
     pthread_exit(NULL);
@@ -38,58 +133,370 @@ static void *memory_profiler_thread(void *mpt_raw)
 
 int init_memory_profiler(memory_profiler_t *mpt)
 {
-    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-    mpt->lock = lock;
-    mpt->running = 1;
-    mpt->max_mem_usage = 0;
+    atomic_init(&mpt->running, 1);
+    atomic_init(&mpt->epoch, 0);
+    atomic_init(&mpt->start_mem_usage, 0);
+    atomic_init(&mpt->max_mem_usage, 0);
+    atomic_init(&mpt->start_rss, 0);
+    atomic_init(&mpt->max_rss, 0);
+    atomic_init(&mpt->start_pss, 0);
+    atomic_init(&mpt->max_pss, 0);
+
+    mpt->statm_fd = mpt->smaps_fd = -1;
+    if (mpt->sample_rss && (mpt->statm_fd = open("/proc/self/statm", O_RDONLY)) < 0) {
+        lprintf(LOG_WARNING, "Cannot open /proc/self/statm, rss will be 0\n");
+    }
+    if (mpt->sample_pss && (mpt->smaps_fd = open("/proc/self/smaps_rollup", O_RDONLY)) < 0) {
+        lprintf(LOG_WARNING, "Cannot open /proc/self/smaps_rollup, pss will be 0\n");
+    }
+
+    calibrate_memory_profiler(mpt);
 
-    pthread_mutex_lock(&mpt->lock);
     int s = pthread_create(&mpt->thread, NULL, &memory_profiler_thread, (void *) mpt);
     if (s != 0) {
         lprintf(LOG_ERROR, "Cannot start memory profiler thread\n");
+        if (mpt->statm_fd >= 0) {
+            close(mpt->statm_fd);
+        }
+        if (mpt->smaps_fd >= 0) {
+            close(mpt->smaps_fd);
+        }
         return 0;
     }
-    /*
-     The thread will start by unlocking the mutex, this will flag that it has started.
-     The calibrate_memory_profiler call is locking meaning that it waits for the mutex to be unlocked by said
-     thread start.
-     */
-
-    calibrate_memory_profiler(mpt);
 
     return 1;
 }
 
 void free_memory_profiler(memory_profiler_t *mpt)
 {
-    pthread_mutex_lock(&mpt->lock);
-    mpt->running = 0;
-    pthread_mutex_unlock(&mpt->lock);
+    atomic_store(&mpt->running, 0);
 
     void *__ret;
     pthread_join(mpt->thread, &__ret);
-    pthread_mutex_destroy(&mpt->lock);
+    if (mpt->statm_fd >= 0) {
+        close(mpt->statm_fd);
+    }
+    if (mpt->smaps_fd >= 0) {
+        close(mpt->smaps_fd);
+    }
+}
+
+/// The page faults of this process so far
+static void get_page_faults(size_t *minor, size_t *major)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        *minor = *major = 0;
+        return;
+    }
+    *minor = usage.ru_minflt;
+    *major = usage.ru_majflt;
 }
 
 void calibrate_memory_profiler(memory_profiler_t *mpt)
 {
-    pthread_mutex_lock(&mpt->lock);
-    mpt->start_mem_usage = get_malloc_info();
-    mpt->max_mem_usage = mpt->start_mem_usage;
-    pthread_mutex_unlock(&mpt->lock);
+    // Samples that are in progress are dropped as they may be from before the calibration, the
+    // peaks are replaced with ones for the new epoch which the old samples do not match
+    unsigned int epoch = atomic_fetch_add_explicit(&mpt->epoch, 1, memory_order_acq_rel) + 1;
+
+    size_t heap = get_heap(mpt);
+    atomic_store(&mpt->start_mem_usage, heap);
+    atomic_store(&mpt->max_mem_usage, peak_word(epoch, heap));
+
+    size_t rss = mpt->sample_rss ? get_rss(mpt) : 0;
+    atomic_store(&mpt->start_rss, rss);
+    atomic_store(&mpt->max_rss, peak_word(epoch, rss));
+
+    size_t pss = mpt->sample_pss ? get_pss(mpt) : 0;
+    atomic_store(&mpt->start_pss, pss);
+    atomic_store(&mpt->max_pss, peak_word(epoch, pss));
+
+    get_page_faults(&mpt->start_minor_faults, &mpt->start_major_faults);
+}
+
+/// The increase of max over start, 0 if it has gone down
+static size_t peak_since_calibration(atomic_size_t *start, atomic_uint_least64_t *max)
+{
+    size_t s = atomic_load(start), m = atomic_load(max) & PEAK_VALUE_MASK;
+    return m > s ? m - s : 0;
 }
 
 long max_mem_usage(memory_profiler_t *mpt)
 {
-    long ret;
-    pthread_mutex_lock(&mpt->lock);
-    if (mpt->max_mem_usage < mpt->start_mem_usage) {
-        ret = 0;
-        lprintf(LOG_WARNING, "Memory usage is negative, calibration may be wrong\n");
-    } else {
-        ret = mpt->max_mem_usage - mpt->start_mem_usage;
+    sample_memory(mpt);
+    return peak_since_calibration(&mpt->start_mem_usage, &mpt->max_mem_usage);
+}
+
+void memory_profiler_usage(memory_profiler_t *mpt, memory_usage_t *usage)
+{
+    sample_memory(mpt);
+    usage->heap = peak_since_calibration(&mpt->start_mem_usage, &mpt->max_mem_usage);
+    usage->rss = peak_since_calibration(&mpt->start_rss, &mpt->max_rss);
+    usage->pss = peak_since_calibration(&mpt->start_pss, &mpt->max_pss);
+
+    size_t minor, major;
+    get_page_faults(&minor, &major);
+    usage->minor_faults = minor - mpt->start_minor_faults;
+    usage->major_faults = major - mpt->start_major_faults;
+}
+
+
+/// Reads the ticks that a thread has spent in user and, kernel mode, 0 on failure
+static int read_thread_ticks(const char *tid, unsigned long long *ticks, int *is_profiler)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%s/stat", tid);
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    char buffer[1024];
+    size_t len = fread(buffer, 1, sizeof(buffer) - 1, f);
+    fclose(f);
+    buffer[len] = 0;
+
+    // The comm can contain spaces and, brackets so parse from the last bracket
+    char *comm = strchr(buffer, '(');
+    char *fields = strrchr(buffer, ')');
+    if (comm == NULL || fields == NULL) {
+        return 0;
+    }
+    *is_profiler = strncmp(comm + 1, PROFILER_THREAD_PREFIX, strlen(PROFILER_THREAD_PREFIX)) == 0;
+
+    // Fields after the comm start at field 3 (state), utime and, stime are fields 14 and, 15
+    unsigned long long utime, stime;
+    if (sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        return 0;
+    }
+
+    *ticks = utime + stime;
+    return 1;
+}
+
+/// Samples all threads of this process, cpt->lock must be held
+static void sample_threads(cpu_profiler_t *cpt, int calibrating)
+{
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == NULL) {
+        lprintf(LOG_ERROR, "Cannot open /proc/self/task\n");
+        return;
     }
-    pthread_mutex_unlock(&mpt->lock);
-    return ret;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+
+        unsigned long long ticks;
+        int is_profiler;
+        if (!read_thread_ticks(ent->d_name, &ticks, &is_profiler) || is_profiler) {
+            continue;
+        }
+
+        int tid = atoi(ent->d_name);
+        size_t i;
+        for (i = 0; i < cpt->threads_len && cpt->threads[i].tid != tid; i++);
+
+        if (i == cpt->threads_len) {
+            if (cpt->threads_len == cpt->threads_capacity) {
+                size_t capacity = cpt->threads_capacity > 0 ? cpt->threads_capacity * 2 : 8;
+                cpu_thread_sample_t *tmp = realloc(cpt->threads, sizeof(*cpt->threads) * capacity);
+                if (tmp == NULL) {
+                    lprintf(LOG_ERROR, "Cannot realloc thread samples\n");
+                    break;
+                }
+                cpt->threads = tmp;
+                cpt->threads_capacity = capacity;
+            }
+            cpt->threads_len++;
+
+            // Threads that started after calibration have used all of their time in the run
+            cpt->threads[i].tid = tid;
+            cpt->threads[i].start_ticks = calibrating ? ticks : 0;
+        } else if (calibrating) {
+            cpt->threads[i].start_ticks = ticks;
+        }
+        cpt->threads[i].last_ticks = ticks;
+        cpt->threads[i].seen = 1;
+    }
+
+    closedir(dir);
 }
 
+/// Drops the threads that were not found by a calibration, they have exited and, their tid
+/// could be reused by a new thread
+static void drop_exited_threads(cpu_profiler_t *cpt)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < cpt->threads_len; i++) {
+        if (cpt->threads[i].seen) {
+            cpt->threads[len++] = cpt->threads[i];
+        }
+    }
+    cpt->threads_len = len;
+}
+
+/// Reads the busy ticks of each core from /proc/stat, output has cpt->cores values
+static int read_core_busy(cpu_profiler_t *cpt, unsigned long long *output)
+{
+    FILE *f = fopen("/proc/stat", "r");
+    if (f == NULL) {
+        lprintf(LOG_ERROR, "Cannot open /proc/stat\n");
+        return 0;
+    }
+
+    memset(output, 0, sizeof(*output) * cpt->cores);
+
+    char line[512];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        size_t core;
+        unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+        steal = 0;
+        if (sscanf(line, "cpu%zu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &core, &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) < 8) {
+            // Also skips the aggregate cpu line
+            continue;
+        }
+
+        if (core < cpt->cores) {
+            output[core] = user + nice + system + irq + softirq + steal;
+        }
+    }
+
+    fclose(f);
+    return 1;
+}
+
+static unsigned long long ticks_to_us(unsigned long long ticks)
+{
+    return ticks * 1000000 / sysconf(_SC_CLK_TCK);
+}
+
+static void *cpu_profiler_thread(void *cpt_raw)
+{
+    cpu_profiler_t *cpt = (cpu_profiler_t *) cpt_raw;
+    pthread_setname_np(pthread_self(), PROFILER_THREAD_PREFIX "cpu-prof");
+    alloc_tracker_ignore_thread(1);
+
+    pthread_mutex_lock(&cpt->lock);
+    while (cpt->running) {
+        sample_threads(cpt, 0);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += cpt->poll_time / 1000;
+        deadline.tv_nsec += (cpt->poll_time % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        // Waiting on a condition allows free_cpu_profiler to wake the thread instead of waiting for the poll
+        int s = 0;
+        while (cpt->running && s != ETIMEDOUT) {
+            s = pthread_cond_timedwait(&cpt->wake, &cpt->lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&cpt->lock);
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+int init_cpu_profiler(cpu_profiler_t *cpt)
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+    cpt->lock = lock;
+    cpt->wake = wake;
+    cpt->running = 1;
+    cpt->threads = NULL;
+    cpt->threads_len = 0;
+    cpt->threads_capacity = 0;
+
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    cpt->cores = cores > 0 ? cores : 1;
+    cpt->start_core_busy = malloc(sizeof(*cpt->start_core_busy) * cpt->cores);
+    if (cpt->start_core_busy == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc core samples\n");
+        return 0;
+    }
+
+    calibrate_cpu_profiler(cpt);
+
+    int s = pthread_create(&cpt->thread, NULL, &cpu_profiler_thread, (void *) cpt);
+    if (s != 0) {
+        lprintf(LOG_ERROR, "Cannot start cpu profiler thread\n");
+        free(cpt->start_core_busy);
+        return 0;
+    }
+
+    return 1;
+}
+
+void free_cpu_profiler(cpu_profiler_t *cpt)
+{
+    pthread_mutex_lock(&cpt->lock);
+    cpt->running = 0;
+    pthread_cond_signal(&cpt->wake);
+    pthread_mutex_unlock(&cpt->lock);
+
+    void *__ret;
+    pthread_join(cpt->thread, &__ret);
+    pthread_cond_destroy(&cpt->wake);
+    pthread_mutex_destroy(&cpt->lock);
+
+    free(cpt->start_core_busy);
+    if (cpt->threads != NULL) {
+        free(cpt->threads);
+    }
+}
+
+void calibrate_cpu_profiler(cpu_profiler_t *cpt)
+{
+    pthread_mutex_lock(&cpt->lock);
+    for (size_t i = 0; i < cpt->threads_len; i++) {
+        cpt->threads[i].seen = 0;
+    }
+    sample_threads(cpt, 1);
+    drop_exited_threads(cpt);
+    read_core_busy(cpt, cpt->start_core_busy);
+    pthread_mutex_unlock(&cpt->lock);
+}
+
+long cpu_core_time_us(cpu_profiler_t *cpt)
+{
+    unsigned long long ticks = 0;
+    pthread_mutex_lock(&cpt->lock);
+    sample_threads(cpt, 0);
+    for (size_t i = 0; i < cpt->threads_len; i++) {
+        ticks += cpt->threads[i].last_ticks - cpt->threads[i].start_ticks;
+    }
+    pthread_mutex_unlock(&cpt->lock);
+    return ticks_to_us(ticks);
+}
+
+int cpu_per_core_time_us(cpu_profiler_t *cpt, size_t *output)
+{
+    unsigned long long *busy = malloc(sizeof(*busy) * cpt->cores);
+    if (busy == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc core samples\n");
+        return 0;
+    }
+
+    pthread_mutex_lock(&cpt->lock);
+    int r = read_core_busy(cpt, busy);
+    if (r) {
+        for (size_t i = 0; i < cpt->cores; i++) {
+            unsigned long long start = cpt->start_core_busy[i];
+            output[i] = busy[i] > start ? ticks_to_us(busy[i] - start) : 0;
+        }
+    }
+    pthread_mutex_unlock(&cpt->lock);
+
+    free(busy);
+    return r;
+}
@@ -1,13 +1,55 @@
 #pragma once
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
+/// The memory usage of this process since the last calibration, in bytes
+typedef struct memory_usage_t {
+    /// The peak of the bytes malloc has handed out (mallinfo2), 0 if memory_profiler_t::skip_heap
+    /// is set
+    size_t heap;
+    /// The peak resident set size, 0 if memory_profiler_t::sample_rss is not set
+    size_t rss;
+    /// The peak proportional set size, 0 if memory_profiler_t::sample_pss is not set or,
+    /// /proc/self/smaps_rollup cannot be read
+    size_t pss;
+    /// Page faults (getrusage), these are counts not bytes
+    size_t minor_faults;
+    size_t major_faults;
+} memory_usage_t;
+
+/// Polls the memory usage of this process on a thread, the peaks are published with atomics
+/// so that reading them does not block the sampler or, the code that is being measured.
+/// Set poll_time, skip_heap, sample_rss and, sample_pss before calling init_memory_profiler.
 typedef struct memory_profiler_t {
     pthread_t thread;
-    pthread_mutex_t lock;
-    size_t start_mem_usage;
-    size_t max_mem_usage;
+    /// ms between samples
     size_t poll_time;
-    int running;
+    /// Whether to not poll mallinfo2, which takes the lock of every malloc arena so each poll can
+    /// stall the allocations of the code that is being measured
+    int skip_heap;
+    /// Whether to poll /proc/self/statm
+    int sample_rss;
+    /// Whether to poll /proc/self/smaps_rollup, this is slow as the kernel walks the page tables
+    int sample_pss;
+    atomic_int running;
+    /// Incremented by each calibration so that the sampler can drop samples from before it
+    atomic_uint epoch;
+    /// The peaks have the epoch that they are for in their top bits, so a sample that was taken
+    /// before a calibration cannot raise the peak after it
+    atomic_size_t start_mem_usage;
+    atomic_uint_least64_t max_mem_usage;
+    atomic_size_t start_rss;
+    atomic_uint_least64_t max_rss;
+    atomic_size_t start_pss;
+    atomic_uint_least64_t max_pss;
+    /// Only used by the thread that calibrates the profiler
+    size_t start_minor_faults;
+    size_t start_major_faults;
+    /// Kept open so that a sample does not allocate, -1 if not used
+    int statm_fd;
+    int smaps_fd;
 } memory_profiler_t;
 
 /// Inits and, starts the memory profiler, returning when the thread is active
@@ -19,6 +61,54 @@ void free_memory_profiler(memory_profiler_t *mpt);
 /// Sets the start_mem_usage to allow for results to ignore the current heap size
 void calibrate_memory_profiler(memory_profiler_t *mpt);
 
-/// Thread safe getter for the max memory usage
+/// Thread safe getter for the max memory usage, this takes a sample as well so that
+/// usage since the last poll is not missed
 long max_mem_usage(memory_profiler_t *mpt);
 
+/// Thread safe getter for all of the memory usage since calibration, this takes a sample as well
+void memory_profiler_usage(memory_profiler_t *mpt, memory_usage_t *usage);
+
+
+/// CPU time of a single thread of this process, in clock ticks
+typedef struct cpu_thread_sample_t {
+    int tid;
+    unsigned long long start_ticks;
+    unsigned long long last_ticks;
+    /// Whether the thread was found by the last calibration
+    int seen;
+} cpu_thread_sample_t;
+
+typedef struct cpu_profiler_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    /// ms between samples of /proc/self/task
+    size_t poll_time;
+    int running;
+    /// Number of cores that /proc/stat can report on
+    size_t cores;
+    /// Busy ticks of each core at the last calibration
+    unsigned long long *start_core_busy;
+    /// Every thread that has been seen since the last calibration, this lets threads
+    /// that exit between polls still be counted. This is kept between calibrations
+    cpu_thread_sample_t *threads;
+    size_t threads_len;
+    size_t threads_capacity;
+} cpu_profiler_t;
+
+/// Inits and, starts the cpu profiler, returning when the thread is active
+int init_cpu_profiler(cpu_profiler_t *cpt);
+
+/// Join and, frees a profiler.
+void free_cpu_profiler(cpu_profiler_t *cpt);
+
+/// Resets the per thread and, per core times to allow for results to ignore previous runs
+void calibrate_cpu_profiler(cpu_profiler_t *cpt);
+
+/// Thread safe getter for the cpu time used by all threads of this process since calibration,
+/// the profiler threads are not counted
+long cpu_core_time_us(cpu_profiler_t *cpt);
+
+/// Thread safe getter for the busy time of each core since calibration, this is system wide.
+/// output must have space for cpt->cores values, 0 on failure
+int cpu_per_core_time_us(cpu_profiler_t *cpt, size_t *output);
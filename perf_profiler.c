@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include "./perf_profiler.h"
+#include "./testing.h/logger.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef struct perf_counter_def_t {
+    const char *name;
+    perf_group_t group;
+    uint32_t type;
+    uint64_t config;
+} perf_counter_def_t;
+
+#define HW_CACHE_CONFIG(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+static const perf_counter_def_t counter_defs[PERF_COUNTERS] = {
+    {"cycles", PERF_GROUP_CORE, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_GROUP_CORE, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache_references", PERF_GROUP_CACHE, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache_misses", PERF_GROUP_CACHE, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch_misses", PERF_GROUP_CORE, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {
+        "dtlb_misses", PERF_GROUP_CACHE, PERF_TYPE_HW_CACHE,
+        HW_CACHE_CONFIG(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)
+    },
+    {"context_switches", PERF_GROUP_SOFTWARE, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+};
+
+/// The layout of a read of a group with PERF_FORMAT_GROUP | PERF_FORMAT_ID and, the times
+typedef struct perf_group_read_t {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    struct {
+        uint64_t value;
+        uint64_t id;
+    } values[PERF_COUNTERS];
+} perf_group_read_t;
+
+/// Reads /proc/sys/kernel/perf_event_paranoid, -1 if it cannot be read
+static int perf_event_paranoid()
+{
+    FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (f == NULL) {
+        return -1;
+    }
+
+    int ret;
+    if (fscanf(f, "%d", &ret) != 1) {
+        ret = -1;
+    }
+    fclose(f);
+    return ret;
+}
+
+static int open_counter(perf_counter_t counter, int group_fd, int exclude_kernel)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter_defs[counter].type;
+    attr.config = counter_defs[counter].config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID
+                       | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread on any cpu
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+int init_perf_profiler(perf_profiler_t *ppt)
+{
+    for (size_t i = 0; i < PERF_GROUPS; i++) {
+        ppt->leaders[i] = -1;
+    }
+    ppt->available = 0;
+    ppt->counted = 0;
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        ppt->fds[i] = -1;
+    }
+
+    // Kernel events need paranoid < 2 for normal users
+    int exclude_kernel = perf_event_paranoid() >= 2 && geteuid() != 0;
+
+    // The first counter of a group that opens becomes its leader so that a missing counter
+    // still leaves the rest of the group
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        int *leader = &ppt->leaders[counter_defs[i].group];
+        int fd = open_counter(i, *leader, exclude_kernel);
+        if (fd < 0) {
+            continue;
+        }
+
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &ppt->ids[i]) != 0) {
+            close(fd);
+            continue;
+        }
+
+        if (*leader == -1) {
+            *leader = fd;
+        }
+        ppt->fds[i] = fd;
+        ppt->available |= 1 << i;
+    }
+
+    if (ppt->available == 0) {
+        lprintf(LOG_WARNING, "No perf counters are available (perf_event_paranoid is %d)\n", perf_event_paranoid());
+    }
+    return 1;
+}
+
+void free_perf_profiler(perf_profiler_t *ppt)
+{
+    if (ppt == NULL) return;
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        if (ppt->fds[i] >= 0) {
+            close(ppt->fds[i]);
+            ppt->fds[i] = -1;
+        }
+    }
+    for (size_t i = 0; i < PERF_GROUPS; i++) {
+        ppt->leaders[i] = -1;
+    }
+    ppt->available = 0;
+    ppt->counted = 0;
+}
+
+void start_perf_profiler(perf_profiler_t *ppt)
+{
+    for (size_t i = 0; i < PERF_GROUPS; i++) {
+        if (ppt->leaders[i] >= 0) {
+            ioctl(ppt->leaders[i], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(ppt->leaders[i], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+/// Reads a stopped group into output, scaling it by the share of the run that it was counted for
+static int read_perf_group(perf_profiler_t *ppt, int leader, uint64_t *output)
+{
+    perf_group_read_t data;
+    if (read(leader, &data, sizeof(data)) < (ssize_t) (3 * sizeof(uint64_t))) {
+        lprintf(LOG_ERROR, "Cannot read perf counters\n");
+        return 0;
+    }
+
+    // The group was never on the PMU so there is nothing to scale, the run is not counted
+    if (data.time_running == 0) {
+        return 1;
+    }
+
+    // The kernel multiplexes the groups when they do not all fit on the PMU at once
+    double scale = 1;
+    if (data.time_running < data.time_enabled) {
+        scale = (double) data.time_enabled / data.time_running;
+    }
+
+    for (size_t i = 0; i < data.nr && i < PERF_COUNTERS; i++) {
+        for (size_t j = 0; j < PERF_COUNTERS; j++) {
+            if ((ppt->available & (1 << j)) && ppt->ids[j] == data.values[i].id) {
+                output[j] = (uint64_t) (data.values[i].value * scale);
+                ppt->counted |= 1 << j;
+            }
+        }
+    }
+    return 1;
+}
+
+int stop_perf_profiler(perf_profiler_t *ppt, uint64_t *output)
+{
+    memset(output, 0, sizeof(*output) * PERF_COUNTERS);
+    ppt->counted = 0;
+
+    // All of the groups are stopped before any are read so that they cover the same run
+    for (size_t i = 0; i < PERF_GROUPS; i++) {
+        if (ppt->leaders[i] >= 0) {
+            ioctl(ppt->leaders[i], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    for (size_t i = 0; i < PERF_GROUPS; i++) {
+        if (ppt->leaders[i] >= 0 && !read_perf_group(ppt, ppt->leaders[i], output)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+const char *perf_counter_name(perf_counter_t counter)
+{
+    if (counter >= PERF_COUNTERS) {
+        return "unknown";
+    }
+    return counter_defs[counter].name;
+}
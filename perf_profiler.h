@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The hardware (and, software) counters that are read for each run
+typedef enum perf_counter_t {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_REFERENCES,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    /// The number of counters
+    PERF_COUNTERS
+} perf_counter_t;
+
+/// The counters are opened in small groups, the kernel only schedules a group if all of its
+/// counters fit on the PMU at once so one group of all of them may never be counted
+typedef enum perf_group_t {
+    /// cycles, instructions and, branch misses
+    PERF_GROUP_CORE,
+    /// cache references, cache misses and, dTLB misses
+    PERF_GROUP_CACHE,
+    /// Software counters, these do not use the PMU
+    PERF_GROUP_SOFTWARE,
+    /// The number of groups
+    PERF_GROUPS
+} perf_group_t;
+
+/// The perf_event_open counters for the thread that inits it.
+/// Counters that cannot be opened (perf_event_paranoid, no PMU in a VM, etc...) are left out of
+/// their group and, their bit in available is not set.
+typedef struct perf_profiler_t {
+    /// The leader of each group, -1 if none of the group's counters could be opened
+    int leaders[PERF_GROUPS];
+    int fds[PERF_COUNTERS];
+    /// The id of each counter in the group read format
+    uint64_t ids[PERF_COUNTERS];
+    /// Bit i is set if counter i was opened
+    uint32_t available;
+    /// Bit i is set if counter i was counted in the last stop_perf_profiler, the kernel may not
+    /// schedule a group at all in a short run
+    uint32_t counted;
+} perf_profiler_t;
+
+/// Opens the counters for the calling thread, 0 on failure. If no counters are available this
+/// still succeeds with available set to 0 and, a warning is logged.
+int init_perf_profiler(perf_profiler_t *ppt);
+
+/// Closes the counters
+void free_perf_profiler(perf_profiler_t *ppt);
+
+/// Resets and, starts the counters
+void start_perf_profiler(perf_profiler_t *ppt);
+
+/// Stops the counters and, reads them into output, which must have space for PERF_COUNTERS
+/// values. Counters that are not available or, were not counted (see counted) are set to 0.
+/// Each group is scaled by the share of the run that it was on the PMU for, when the groups do
+/// not all fit at once the kernel multiplexes them. 0 on failure
+int stop_perf_profiler(perf_profiler_t *ppt, uint64_t *output);
+
+/// The name of a counter, i.e: "cycles"
+const char *perf_counter_name(perf_counter_t counter);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,18 +4,119 @@
 #include <math.h>
 #include <stdarg.h>
 
+/// Allows for (end - start) / step to be a little under a whole number due to rounding
+#define RANGE_EPSILON 1e-9
+
+range_t range_linear(double start, double end, double step)
+{
+    range_t range = RANGE_T_DEFAULT;
+    range.start = start;
+    range.end = end;
+    range.step = step;
+    return range;
+}
+
+range_t range_geometric(double start, double end, double ratio)
+{
+    range_t range = range_linear(start, end, ratio);
+    range.kind = RANGE_GEOMETRIC;
+    return range;
+}
+
+range_t range_log(double start, double end, size_t count)
+{
+    range_t range = range_linear(start, end, 0);
+    range.kind = RANGE_LOG;
+    range.count = count;
+    return range;
+}
+
+range_t range_integer(long start, long end, long step)
+{
+    range_t range = range_linear(start, end, step);
+    range.kind = RANGE_INTEGER;
+    return range;
+}
+
+range_t range_list(const double *values, size_t len)
+{
+    range_t range = RANGE_T_DEFAULT;
+    range.kind = RANGE_LIST;
+    range.values = values;
+    range.count = len;
+    if (len > 0) {
+        range.start = values[0];
+        range.end = values[len - 1];
+    }
+    return range;
+}
+
+size_t range_len(range_t *range)
+{
+    switch (range->kind) {
+    case RANGE_LINEAR:
+        if (!isgreater(range->step, 0) || isless(range->end, range->start)) {
+            return 1;
+        }
+        return (size_t) floor((range->end - range->start) / range->step + RANGE_EPSILON) + 1;
+    case RANGE_GEOMETRIC:
+        if (!isgreater(range->step, 1) || !isgreater(range->start, 0) || isless(range->end, range->start)) {
+            return 1;
+        }
+        return (size_t) floor(log(range->end / range->start) / log(range->step) + RANGE_EPSILON) + 1;
+    case RANGE_LOG:
+        return range->count > 0 ? range->count : 1;
+    case RANGE_INTEGER: {
+        long start = llround(range->start), end = llround(range->end), step = llround(range->step);
+        if (step <= 0 || end < start) {
+            return 1;
+        }
+        return (end - start) / step + 1;
+    }
+    case RANGE_LIST:
+        return range->count;
+    }
+    return 1;
+}
+
+double range_value_at(range_t *range, size_t i)
+{
+    switch (range->kind) {
+    case RANGE_LINEAR:
+        break;
+    case RANGE_GEOMETRIC:
+        return range->start * pow(range->step, i);
+    case RANGE_LOG:
+        if (range->count <= 1) {
+            return range->start;
+        }
+        // The last value is exactly end rather than end with rounding error
+        if (i == range->count - 1) {
+            return range->end;
+        }
+        return range->start * pow(range->end / range->start, (double) i / (range->count - 1));
+    case RANGE_INTEGER:
+        return llround(range->start) + llround(range->step) * (long) i;
+    case RANGE_LIST:
+        return range->values[i];
+    }
+    return range->start + range->step * i;
+}
+
 void range_start(range_t *range)
 {
-    range->current = range->start;
+    range->index = 0;
+    range->current = range_len(range) > 0 ? range_value_at(range, 0) : range->start;
 }
 
 range_state_t range_next(range_t *range, double *output)
 {
-    range->current += range->step;
-    if (isgreater(range->current, range->end)) {
+    if (range->index + 1 >= range_len(range)) {
         return RANGE_STOPPED;
     }
 
+    range->index++;
+    range->current = range_value_at(range, range->index);
     *output = range->current;
     return RANGE_GENERATING;
 }
@@ -27,6 +128,55 @@ void free_vector(vector_t *vect)
     free(vect->values);
 }
 
+int init_param_arena(param_arena_t *arena, size_t capacity)
+{
+    arena->used = 0;
+    arena->capacity = capacity;
+    arena->values = NULL;
+    if (capacity == 0) {
+        return 1;
+    }
+
+    arena->values = malloc(sizeof(*arena->values) * capacity);
+    if (arena->values == NULL) {
+        lprintf(LOG_ERROR, "Cannot malloc param arena\n");
+        return 0;
+    }
+    return 1;
+}
+
+double *param_arena_alloc(param_arena_t *arena, size_t n)
+{
+    if (n > arena->capacity - arena->used) {
+        return NULL;
+    }
+
+    double *ret = &arena->values[arena->used];
+    arena->used += n;
+    return ret;
+}
+
+void free_param_arena(param_arena_t *arena)
+{
+    if (arena == NULL) return;
+    if (arena->values != NULL) {
+        free(arena->values);
+    }
+    arena->values = NULL;
+    arena->capacity = arena->used = 0;
+}
+
+/// Sets a range to generate its full grid
+static void init_range_sampling(multi_dimensional_range_t *range)
+{
+    range->index = 0;
+    range->sampling = SAMPLE_GRID;
+    range->samples = 0;
+    range->seed = 0;
+    range->strata = NULL;
+    range->directions = NULL;
+}
+
 int init_multi_dimensional_range_arr(multi_dimensional_range_t *range, size_t d, range_t *items)
 {
     range->ranges = malloc(sizeof(*range->ranges) * d);
@@ -40,6 +190,7 @@ int init_multi_dimensional_range_arr(multi_dimensional_range_t *range, size_t d,
     }
 
     range->dimensions = d;
+    init_range_sampling(range);
     return 1;
 }
 
@@ -62,6 +213,7 @@ int __va_args_init_multi_dimensional_range(multi_dimensional_range_t *range, siz
     }
 
     range->dimensions = len;
+    init_range_sampling(range);
 
     va_end(ap);
     return 1;
@@ -72,10 +224,7 @@ void multi_dimensional_range_start(multi_dimensional_range_t *range)
     for (size_t i = 0; i < range->dimensions; i++) {
         range_start(&range->ranges[i]);
     }
-
-    // Offset for the algorithm to work
-    size_t i = range->dimensions - 1;
-    range->ranges[i].current -= range->ranges[i].step;
+    range->index = 0;
 }
 
 void free_multi_dimensional_range(multi_dimensional_range_t *range)
@@ -83,35 +232,244 @@ void free_multi_dimensional_range(multi_dimensional_range_t *range)
     if (range == NULL) return;
     if (range->ranges != NULL)
         free(range->ranges);
+    if (range->strata != NULL)
+        free(range->strata);
+    if (range->directions != NULL)
+        free(range->directions);
 }
 
-range_state_t multi_dimensional_range_next(multi_dimensional_range_t *range, vector_t *output)
+/// Bits in each Sobol coordinate
+#define SOBOL_BITS 32
+
+/// Joe and, Kuo's primitive polynomials and, initial direction numbers (new-joe-kuo-6.21201),
+/// the first dimension is the van der Corput sequence
+static const struct {
+    unsigned int s, a, m[6];
+} sobol_polynomials[SOBOL_MAX_DIMENSIONS - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}}
+};
+
+static const unsigned int halton_primes[HALTON_MAX_DIMENSIONS] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+};
+
+/// A counter based generator so that any sample can be computed from its index
+static uint64_t splitmix64(uint64_t x)
 {
-    // Iterate the last dimension, when reset then repeat for the next dimension
-    long ptr = range->dimensions - 1;
-    output->dimensions = 0;
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/// A uniform double in [0, 1) for a sample index and, dimension
+static double sample_uniform(multi_dimensional_range_t *range, size_t index, size_t dim, uint64_t stream)
+{
+    uint64_t x = splitmix64(range->seed ^ splitmix64(stream ^ splitmix64(index * range->dimensions + dim)));
+    return (x >> 11) * 0x1.0p-53;
+}
+
+static void init_sobol_directions(uint32_t *v, size_t dim)
+{
+    if (dim == 0) {
+        for (size_t i = 0; i < SOBOL_BITS; i++) {
+            v[i] = 1u << (SOBOL_BITS - 1 - i);
+        }
+        return;
+    }
+
+    unsigned int s = sobol_polynomials[dim - 1].s, a = sobol_polynomials[dim - 1].a;
+    for (size_t i = 0; i < s; i++) {
+        v[i] = sobol_polynomials[dim - 1].m[i] << (SOBOL_BITS - 1 - i);
+    }
+    for (size_t i = s; i < SOBOL_BITS; i++) {
+        v[i] = v[i - s] ^ (v[i - s] >> s);
+        for (size_t k = 1; k < s; k++) {
+            v[i] ^= ((a >> (s - 1 - k)) & 1) * v[i - k];
+        }
+    }
+}
+
+int multi_dimensional_range_sample(multi_dimensional_range_t *range, range_sampling_t sampling,
+                                   size_t samples, uint64_t seed)
+{
+    if (sampling == SAMPLE_SOBOL && range->dimensions > SOBOL_MAX_DIMENSIONS) {
+        lprintf(LOG_ERROR, "Sobol sampling supports up to %d dimensions\n", SOBOL_MAX_DIMENSIONS);
+        return 0;
+    }
+    if (sampling == SAMPLE_HALTON && range->dimensions > HALTON_MAX_DIMENSIONS) {
+        lprintf(LOG_ERROR, "Halton sampling supports up to %d dimensions\n", HALTON_MAX_DIMENSIONS);
+        return 0;
+    }
+
+    if (range->strata != NULL) {
+        free(range->strata);
+        range->strata = NULL;
+    }
+    if (range->directions != NULL) {
+        free(range->directions);
+        range->directions = NULL;
+    }
+
+    range->sampling = sampling;
+    range->samples = samples;
+    range->seed = seed;
+    range->index = 0;
+
+    if (sampling == SAMPLE_LATIN_HYPERCUBE && samples > 0) {
+        range->strata = malloc(sizeof(*range->strata) * samples * range->dimensions);
+        if (range->strata == NULL) {
+            lprintf(LOG_ERROR, "Cannot malloc latin hypercube strata\n");
+            return 0;
+        }
+
+        // An independent Fisher-Yates shuffle of the strata for each dimension
+        for (size_t d = 0; d < range->dimensions; d++) {
+            size_t *strata = &range->strata[d * samples];
+            for (size_t i = 0; i < samples; i++) {
+                strata[i] = i;
+            }
+            for (size_t i = samples - 1; i > 0; i--) {
+                size_t j = splitmix64(seed ^ splitmix64(d * samples + i)) % (i + 1);
+                size_t tmp = strata[i];
+                strata[i] = strata[j];
+                strata[j] = tmp;
+            }
+        }
+    }
 
-    range_state_t ret = RANGE_GENERATING;
-    int flag = 1;
-    while (flag) {
-        if (ptr < 0) {
-            flag = 0;
-            ret = RANGE_STOPPED;
-        } else {
-            double __val; // Not used
-            range_state_t state = range_next(&range->ranges[ptr], &__val);
-            if (state == RANGE_STOPPED) {
-                range_start(&range->ranges[ptr]);
-                ptr--;
-            } else {
-                flag = 0;
+    if (sampling == SAMPLE_SOBOL) {
+        range->directions = malloc(sizeof(*range->directions) * SOBOL_BITS * range->dimensions);
+        if (range->directions == NULL) {
+            lprintf(LOG_ERROR, "Cannot malloc sobol direction numbers\n");
+            return 0;
+        }
+        for (size_t d = 0; d < range->dimensions; d++) {
+            init_sobol_directions(&range->directions[d * SOBOL_BITS], d);
+        }
+    }
+
+    return 1;
+}
+
+/// The radical inverse of index in a base, this is the Halton sequence for a prime base
+static double radical_inverse(size_t index, unsigned int base)
+{
+    double ret = 0, f = 1.0 / base;
+    for (; index > 0; index /= base, f /= base) {
+        ret += f * (index % base);
+    }
+    return ret;
+}
+
+/// The coordinate of a sample in [0, 1) for a dimension
+static double sample_coordinate(multi_dimensional_range_t *range, size_t index, size_t dim)
+{
+    double u = 0;
+    switch (range->sampling) {
+    case SAMPLE_GRID:
+    case SAMPLE_RANDOM:
+        return sample_uniform(range, index, dim, 0);
+    case SAMPLE_LATIN_HYPERCUBE:
+        return (range->strata[dim * range->samples + index] + sample_uniform(range, index, dim, 1)) / range->samples;
+    case SAMPLE_SOBOL: {
+        uint32_t x = 0, *v = &range->directions[dim * SOBOL_BITS];
+        for (size_t i = 0, bits = index; bits > 0 && i < SOBOL_BITS; i++, bits >>= 1) {
+            if (bits & 1) {
+                x ^= v[i];
             }
         }
+        u = x * 0x1.0p-32;
+        break;
+    }
+    case SAMPLE_HALTON:
+        // The first point is skipped as it is 0 in every dimension
+        u = radical_inverse(index + 1, halton_primes[dim]);
+        break;
     }
 
-    if (ret == RANGE_STOPPED) {
-        output->values = NULL;
-        return ret;
+    // A seeded random shift (Cranley-Patterson rotation) keeps the spacing of the sequence
+    if (range->seed != 0) {
+        u += sample_uniform(range, 0, dim, 2);
+        u -= floor(u);
+    }
+    return u;
+}
+
+size_t multi_dimensional_range_len(multi_dimensional_range_t *range)
+{
+    if (range->dimensions == 0) {
+        return 0;
+    }
+    if (range->sampling != SAMPLE_GRID) {
+        return range->samples;
+    }
+
+    size_t len = 1;
+    for (size_t i = 0; i < range->dimensions; i++) {
+        len *= range_len(&range->ranges[i]);
+    }
+    return len;
+}
+
+int multi_dimensional_range_at(multi_dimensional_range_t *range, size_t index, double *values)
+{
+    if (index >= multi_dimensional_range_len(range)) {
+        return 0;
+    }
+
+    // Each range is split into a cell per value, a sample takes the value of the cell it is in
+    if (range->sampling != SAMPLE_GRID) {
+        for (size_t i = 0; i < range->dimensions; i++) {
+            range_t *r = &range->ranges[i];
+            size_t len = range_len(r);
+            size_t j = (size_t) (sample_coordinate(range, index, i) * len);
+            values[i] = range_value_at(r, j < len ? j : len - 1);
+        }
+        return 1;
+    }
+
+    // The index is a mixed radix number with the last dimension as the least significant digit
+    for (size_t i = range->dimensions; i > 0; i--) {
+        range_t *r = &range->ranges[i - 1];
+        size_t len = range_len(r);
+        values[i - 1] = range_value_at(r, index % len);
+        index /= len;
+    }
+    return 1;
+}
+
+range_state_t multi_dimensional_range_next_into(multi_dimensional_range_t *range, double *values)
+{
+    if (!multi_dimensional_range_at(range, range->index, values)) {
+        return RANGE_STOPPED;
+    }
+
+    range->index++;
+    return RANGE_GENERATING;
+}
+
+range_state_t multi_dimensional_range_next(multi_dimensional_range_t *range, vector_t *output)
+{
+    output->dimensions = 0;
+    output->values = NULL;
+    if (range->index >= multi_dimensional_range_len(range)) {
+        return RANGE_STOPPED;
     }
 
     output->values = malloc(sizeof(*output->values) * range->dimensions);
@@ -120,10 +478,7 @@ range_state_t multi_dimensional_range_next(multi_dimensional_range_t *range, vec
         return RANGE_ERROR;
     }
 
-    for (size_t i = 0; i < range->dimensions; i++) {
-        output->values[i] = range->ranges[i].current;
-    }
+    multi_dimensional_range_next_into(range, output->values);
     output->dimensions = range->dimensions;
-
-    return ret;
+    return RANGE_GENERATING;
 }
@@ -1,19 +1,58 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/// Single dimensional iterater range
+/// How the values of a range are computed from their index, values are never accumulated
+/// so that there is no floating point drift.
+typedef enum range_kind_t {
+    /// start, start + step, start + 2 * step, ... up to end
+    RANGE_LINEAR = 0,
+    /// start, start * step, start * step ^ 2, ... up to end, i.e: powers of two with step = 2
+    RANGE_GEOMETRIC,
+    /// count values from start to end (inclusive) that are evenly spaced on a log scale
+    RANGE_LOG,
+    /// Like RANGE_LINEAR but start, end and, step are whole numbers so values are exact
+    RANGE_INTEGER,
+    /// The count values in values, i.e: hand picked cache boundary sizes
+    RANGE_LIST
+} range_kind_t;
+
+/// Single dimensional iterater range, make these with a range_* constructor or, RANGE_T_DEFAULT.
+/// Breaking change: a range_t that only has start, end and, step set has an uninitialised kind,
+/// use range_linear(start, end, step) instead (a zeroed range_t is linear as well)
 typedef struct range_t {
     double start, end, step;
 
     // Internal generator state
     double current;
+
+    range_kind_t kind;
+    /// The number of values for RANGE_LOG and, RANGE_LIST
+    size_t count;
+    /// The values of a RANGE_LIST, these are not copied so must outlive the range
+    const double *values;
+
+    // Internal generator state
+    size_t index;
 } range_t;
 
-#define RANGE_T_DEFAULT {0, 0, 0, 0}
+#define RANGE_T_DEFAULT {0, 0, 0, 0, RANGE_LINEAR, 0, NULL, 0}
+
+/// start to end inclusive, increasing by step
+range_t range_linear(double start, double end, double step);
+/// start to end inclusive, multiplying by ratio (which must be more than 1)
+range_t range_geometric(double start, double end, double ratio);
+/// count values from start to end inclusive that are evenly spaced on a log scale, start and,
+/// end must be positive
+range_t range_log(double start, double end, size_t count);
+/// start to end inclusive, increasing by step
+range_t range_integer(long start, long end, long step);
+/// Each of the len values in order, values is not copied
+range_t range_list(const double *values, size_t len);
 
 /// State of the range iteration
 typedef enum range_state_t {
@@ -28,10 +67,47 @@ void range_start(range_t *range);
 range_state_t range_next(range_t *range,
                          double *output);
 
+/// The number of values that a range has, a linear range with a step that is not positive has 1 value
+size_t range_len(range_t *range);
+/// The i-th value of a range, this does not use or, modify the internal state
+double range_value_at(range_t *range, size_t i);
+
+/// How a multi_dimensional_range_t picks its vectors, sampled vectors are mapped onto the values
+/// of each range so a sample is always a point that the full grid would have had
+typedef enum range_sampling_t {
+    /// Every vector of the Cartesian product of the ranges
+    SAMPLE_GRID = 0,
+    /// Independent uniform random points
+    SAMPLE_RANDOM,
+    /// Each dimension is split into samples strata and, each stratum is used once
+    SAMPLE_LATIN_HYPERCUBE,
+    /// The Sobol low discrepancy sequence, up to SOBOL_MAX_DIMENSIONS
+    SAMPLE_SOBOL,
+    /// The Halton low discrepancy sequence, up to HALTON_MAX_DIMENSIONS
+    SAMPLE_HALTON
+} range_sampling_t;
+
+#define SOBOL_MAX_DIMENSIONS 16
+#define HALTON_MAX_DIMENSIONS 32
+
 /// Multi dimensional ranges struct, use an init_multi_dimensional method
 typedef struct multi_dimensional_range_t {
     size_t dimensions;
     range_t *ranges;
+
+    /// Set with multi_dimensional_range_sample, SAMPLE_GRID by default
+    range_sampling_t sampling;
+    /// The number of vectors to sample, unused for SAMPLE_GRID
+    size_t samples;
+    /// The same seed gives the same samples, 0 gives the unshifted Sobol and, Halton sequences
+    uint64_t seed;
+
+    // Internal generator state, the index of the next vector
+    size_t index;
+    // Internal sampler state, the stratum of each sample in each dimension for SAMPLE_LATIN_HYPERCUBE
+    size_t *strata;
+    // Internal sampler state, the direction numbers of each dimension for SAMPLE_SOBOL
+    uint32_t *directions;
 } multi_dimensional_range_t;
 
 /// Output for an iteration of a multi_dimensional_range_t
@@ -42,6 +118,20 @@ typedef struct vector_t {
 
 void free_vector(vector_t *vect);
 
+/// A bump allocator for vector values, everything in it is freed at once by free_param_arena.
+/// This lets a sweep with many vectors do a single allocation.
+typedef struct param_arena_t {
+    double *values;
+    size_t capacity;
+    size_t used;
+} param_arena_t;
+
+/// Allocates space for capacity values, 0 on failure
+int init_param_arena(param_arena_t *arena, size_t capacity);
+/// Gets space for n values, NULL if the arena is full
+double *param_arena_alloc(param_arena_t *arena, size_t n);
+void free_param_arena(param_arena_t *arena);
+
 #define NUMARGS(t, ...)  (sizeof((t[]){__VA_ARGS__})/sizeof(t))
 
 /// All args must be of type (range_t), 0 on failure,
@@ -62,12 +152,29 @@ int __va_args_init_multi_dimensional_range(multi_dimensional_range_t *range,
 /// Frees a range, call even on error.
 void free_multi_dimensional_range(multi_dimensional_range_t *range);
 
+/// Changes a range to generate samples vectors with a sampling method instead of every vector,
+/// this lets a huge parameter space be covered with a fixed number of benchmark points.
+/// The start, next and, at functions work the same way, 0 on failure
+int multi_dimensional_range_sample(multi_dimensional_range_t *range, range_sampling_t sampling,
+                                   size_t samples, uint64_t seed);
+
 /// Resets the internal state allowing for the range to be (re)started
 void multi_dimensional_range_start(multi_dimensional_range_t *range);
 /// Gets the next value from a range, this modifies its internal state,
 /// output is heap allocated, please free_vector if not null.
 range_state_t multi_dimensional_range_next(multi_dimensional_range_t *range,
         vector_t *output);
+/// Gets the next value from a range without allocating, this modifies its internal state.
+/// values must have space for range->dimensions values.
+range_state_t multi_dimensional_range_next_into(multi_dimensional_range_t *range,
+        double *values);
+
+/// The number of vectors that a range generates, 0 if it has no dimensions.
+/// This is the number of samples if the range is sampled
+size_t multi_dimensional_range_len(multi_dimensional_range_t *range);
+/// Computes the index-th vector of a range directly, the last dimension changes the fastest.
+/// values must have space for range->dimensions values, 0 if index is out of range
+int multi_dimensional_range_at(multi_dimensional_range_t *range, size_t index, double *values);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,107 @@
+#include "./testing.h/testing.h"
+#include "./test_alloc_tracker.h"
+#include "./alloc_tracker.h"
+#include <stdlib.h>
+#include <malloc.h>
+#include <stdint.h>
+
+#define ALLOCS 100
+#define ALLOC_SIZE 1000
+
+// Stops the compiler from removing malloc and, free pairs
+static void *volatile alloc_sink;
+
+static int test_alloc_tracker_counts()
+{
+    void *ptrs[ALLOCS];
+    alloc_stats_t stats;
+
+    alloc_tracker_start();
+    for (size_t i = 0; i < ALLOCS; i++) {
+        ptrs[i] = alloc_sink = malloc(ALLOC_SIZE);
+    }
+    ptrs[0] = alloc_sink = realloc(ptrs[0], 2 * ALLOC_SIZE);
+    for (size_t i = 0; i < ALLOCS; i++) {
+        free(ptrs[i]);
+    }
+    alloc_tracker_stop(&stats);
+
+    if (!alloc_tracker_available()) {
+        lprintf(LOG_WARNING, "Malloc hooks are not compiled in\n");
+        ASSERT(stats.allocations == 0);
+        ASSERT(stats.peak_bytes == 0);
+        return 1;
+    }
+
+    ASSERT(stats.allocations == ALLOCS + 1);
+    ASSERT(stats.frees == ALLOCS + 1);
+    ASSERT(stats.total_bytes == (ALLOCS + 2) * ALLOC_SIZE);
+    ASSERT(stats.peak_bytes >= (ALLOCS + 1) * ALLOC_SIZE);
+    ASSERT(stats.size_classes[alloc_size_class(ALLOC_SIZE)] == ALLOCS);
+    ASSERT(stats.size_classes[alloc_size_class(2 * ALLOC_SIZE)] == 1);
+
+    // Nothing is counted once the tracker is stopped
+    free(alloc_sink = malloc(ALLOC_SIZE));
+    alloc_tracker_stop(&stats);
+    ASSERT(stats.allocations == ALLOCS + 1);
+    return 1;
+}
+
+static int test_alloc_tracker_page_allocs()
+{
+    // The frees of these have to balance their allocations
+    alloc_stats_t stats;
+    alloc_tracker_start();
+    void *a = alloc_sink = valloc(ALLOC_SIZE);
+    void *b = alloc_sink = pvalloc(ALLOC_SIZE);
+    void *c = alloc_sink = reallocarray(NULL, 10, ALLOC_SIZE);
+    c = alloc_sink = reallocarray(c, 20, ALLOC_SIZE);
+    // An overflowing size is not allocated or, counted
+    volatile size_t huge = SIZE_MAX;
+    alloc_sink = reallocarray(NULL, huge, 2);
+    ASSERT(alloc_sink == NULL);
+    free(a);
+    free(b);
+    free(c);
+    alloc_tracker_stop(&stats);
+
+    if (!alloc_tracker_available()) {
+        ASSERT(stats.allocations == 0);
+        return 1;
+    }
+
+    ASSERT(stats.allocations == 4);
+    ASSERT(stats.frees == 4);
+    ASSERT(stats.total_bytes == 2 * ALLOC_SIZE + 30 * ALLOC_SIZE);
+    return 1;
+}
+
+static int test_alloc_tracker_ignore_thread()
+{
+    alloc_stats_t stats;
+    alloc_tracker_start();
+    alloc_tracker_ignore_thread(1);
+    free(alloc_sink = malloc(ALLOC_SIZE));
+    alloc_tracker_ignore_thread(0);
+    alloc_tracker_stop(&stats);
+
+    ASSERT(stats.allocations == 0);
+    ASSERT(stats.frees == 0);
+    return 1;
+}
+
+static int test_alloc_size_class()
+{
+    ASSERT(alloc_size_class(0) == 0);
+    ASSERT(alloc_size_class(1) == 1);
+    ASSERT(alloc_size_class(2) == 2);
+    ASSERT(alloc_size_class(3) == 2);
+    ASSERT(alloc_size_class(1024) == 11);
+    ASSERT(alloc_size_class(SIZE_MAX) == ALLOC_SIZE_CLASSES - 1);
+    return 1;
+}
+
+SUB_TEST(test_alloc_tracker, {&test_alloc_tracker_counts, "Test alloc tracker counts"},
+{&test_alloc_tracker_page_allocs, "Test alloc tracker valloc, pvalloc and, reallocarray"},
+{&test_alloc_tracker_ignore_thread, "Test alloc tracker ignored threads"},
+{&test_alloc_size_class, "Test alloc size classes"})
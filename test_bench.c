@@ -4,6 +4,10 @@
 #include "./ranges.h"
 #include <string.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #define RUNS_TO_AVERAGE 1000
 
@@ -55,10 +59,9 @@ static benchmark_conf_t get_conf_p()
     multi_dimensional_range_t range;
     memset(&range, 0, sizeof(range));
 
-    range_t range_1, range_2, range_3;
-    range_1.start = range_2.start = range_3.start = 1;
-    range_1.end = range_2.end = range_3.end = 3;
-    range_1.step = range_2.step = range_3.step = 1;
+    range_t range_1 = range_linear(1, 3, 1);
+    range_t range_2 = range_linear(1, 3, 1);
+    range_t range_3 = range_linear(1, 3, 1);
 
     init_multi_dimensional_range(&range, range_1, range_2, range_3);
 
@@ -174,6 +177,783 @@ static int test_mem_profiler_bench_np_0()
     return 1;
 }
 
+static int test_cpu_profiler_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.runs_to_average = 10;
+    conf.cpu_conf.enabled = 1;
+    conf.cpu_conf.poll_time = 10;
+
+    // Run the bench
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.entries != NULL);
+    ASSERT(output_profile.len == 1);
+
+    lprintf(LOG_INFO, "example_func_np cpu core time is %lu us\n", output_profile.entries->cpu_core_time_us);
+    ASSERT(output_profile.entries->cpu_cores > 0);
+    ASSERT(output_profile.entries->cpu_core_usage_us != NULL);
+
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+// A function that is far faster than a us
+static int example_func_fast()
+{
+    return 1;
+}
+
+static int test_ns_timer_bench_np()
+{
+    benchmark_timer_type_t timers[] = {TIMER_MONOTONIC, TIMER_RDTSCP};
+    for (size_t t = 0; t < sizeof(timers) / sizeof(*timers); t++) {
+        benchmark_conf_t conf = get_conf_np();
+        conf.np_func = &example_func_fast;
+        conf.timer = timers[t];
+
+        benchmark_profile_t output_profile;
+        ASSERT(benchmark_program(&conf, &output_profile));
+        ASSERT(output_profile.len == 1);
+
+        lprintf(LOG_INFO, "example_func_fast time is %lu ns\n", output_profile.entries->cpu_time_ns);
+        ASSERT(output_profile.entries->cpu_time_us == output_profile.entries->cpu_time_ns / 1000);
+        ASSERT(output_profile.entries->run_times_len == conf.runs_to_average);
+        ASSERT(output_profile.entries->run_times_ns != NULL);
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < output_profile.entries->run_times_len; i++) {
+            total += output_profile.entries->run_times_ns[i];
+        }
+        ASSERT(total > 0);
+        ASSERT(total / conf.runs_to_average == output_profile.entries->cpu_time_ns);
+
+        free_benchmark_profile(&output_profile);
+    }
+    return 1;
+}
+
+static int test_time_stats_bench_p()
+{
+    benchmark_conf_t conf = get_conf_p();
+    conf.runs_to_average = 100;
+    conf.max_run_times = 10;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P);
+
+    for (size_t i = 0; i < output_profile.len; i++) {
+        benchmark_profile_entry_t *entry = &output_profile.entries[i];
+        benchmark_stats_t *stats = &entry->time_stats;
+        ASSERT(entry->run_times_len == conf.max_run_times);
+        ASSERT(stats->min <= stats->p50);
+        ASSERT(stats->p50 <= stats->p90);
+        ASSERT(stats->p90 <= stats->p99);
+        ASSERT(stats->p99 <= stats->p999);
+        ASSERT(stats->p999 <= stats->max);
+        ASSERT(stats->min <= stats->mean && stats->mean <= stats->max);
+        ASSERT(stats->mad <= stats->max - stats->min);
+
+        for (size_t j = 0; j < entry->run_times_len; j++) {
+            ASSERT(entry->run_times_ns[j] >= stats->min);
+            ASSERT(entry->run_times_ns[j] <= stats->max);
+        }
+    }
+
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+static int test_adaptive_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.np_func = &example_func_fast;
+    conf.monitor_func_output = 1;
+    conf.adaptive_conf.enabled = 1;
+    conf.adaptive_conf.min_runs = 10;
+    conf.adaptive_conf.max_runs = 200;
+
+    // Any interval is narrow enough so this stops at min_runs
+    conf.adaptive_conf.target_rel_ci = 1000;
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 1);
+    ASSERT(output_profile.entries->runs == conf.adaptive_conf.min_runs);
+    ASSERT(output_profile.entries->converged);
+    ASSERT(output_profile.entries->run_times_len == output_profile.entries->runs);
+    ASSERT(output_profile.entries->run_outputs_len == output_profile.entries->runs);
+    free_benchmark_profile(&output_profile);
+
+    // No interval is narrow enough so this stops at max_runs
+    conf.adaptive_conf.target_rel_ci = 0;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.entries->runs == conf.adaptive_conf.max_runs);
+    ASSERT(!output_profile.entries->converged);
+    ASSERT(output_profile.entries->run_times_len == output_profile.entries->runs);
+    ASSERT(output_profile.entries->run_outputs_len == output_profile.entries->runs);
+    for (size_t i = 0; i < output_profile.entries->run_outputs_len; i++) {
+        ASSERT(output_profile.entries->run_outputs[i] == 1);
+    }
+    free_benchmark_profile(&output_profile);
+
+    // A negative target is a mistake
+    conf.adaptive_conf.target_rel_ci = -1;
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    free_benchmark_profile(&output_profile);
+
+    return 1;
+}
+
+static int test_adaptive_time_budget_bench_p()
+{
+    benchmark_conf_t conf = get_conf_p();
+    conf.adaptive_conf.enabled = 1;
+    conf.adaptive_conf.min_runs = 2;
+    conf.adaptive_conf.max_runs = 100000000;
+    conf.adaptive_conf.target_rel_ci = 0;
+    conf.adaptive_conf.time_budget = 1;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P);
+    for (size_t i = 0; i < output_profile.len; i++) {
+        ASSERT(output_profile.entries[i].runs >= conf.adaptive_conf.min_runs);
+        ASSERT(output_profile.entries[i].runs < conf.adaptive_conf.max_runs);
+        ASSERT(!output_profile.entries[i].converged);
+    }
+
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+static int test_warmup_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.runs_to_average = 10;
+    conf.warmup_conf.runs = 5;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.entries->warmup_runs == conf.warmup_conf.runs);
+    ASSERT(output_profile.entries->runs == conf.runs_to_average);
+    free_benchmark_profile(&output_profile);
+
+    // Waiting for steady run times is bounded by max_runs
+    benchmark_warmup_conf_t warmup = DEFAULT_BENCHMARK_WARMUP_CONF;
+    conf.warmup_conf = warmup;
+    conf.warmup_conf.max_runs = 100;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    lprintf(LOG_INFO, "example_func_np was steady after %lu runs\n", output_profile.entries->warmup_runs);
+    ASSERT(output_profile.entries->warmup_runs > 0);
+    ASSERT(output_profile.entries->warmup_runs <= conf.warmup_conf.max_runs + 5);
+    ASSERT(output_profile.entries->runs == conf.runs_to_average);
+    free_benchmark_profile(&output_profile);
+
+    return 1;
+}
+
+static int test_cold_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.np_func = &example_func_fast;
+    conf.cold_conf.enabled = 1;
+    conf.cold_conf.runs = 10;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.entries->cold_runs == conf.cold_conf.runs);
+    ASSERT(output_profile.entries->runs == conf.runs_to_average);
+
+    benchmark_stats_t *cold = &output_profile.entries->cold_time_stats;
+    lprintf(LOG_INFO, "example_func_fast is %lf ns cold and, %lf ns warm\n", cold->mean,
+            output_profile.entries->time_stats.mean);
+    ASSERT(cold->max > 0);
+    ASSERT(cold->min <= cold->p50 && cold->p50 <= cold->max);
+
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+static int test_parallel_bench_p()
+{
+    benchmark_conf_t conf = get_conf_p();
+    conf.runs_to_average = 100;
+    benchmark_profile_t serial_profile;
+    ASSERT(benchmark_program(&conf, &serial_profile));
+
+    for (int isolate = 0; isolate <= 1; isolate++) {
+        conf.parallel_conf.threads = 4;
+        conf.parallel_conf.pin = 1;
+        conf.parallel_conf.isolate = isolate;
+        conf.mem_conf.enabled = 1;
+        conf.mem_conf.poll_time = 1;
+
+        benchmark_profile_t output_profile;
+        ASSERT(benchmark_program(&conf, &output_profile));
+        ASSERT(output_profile.len == LEN_EXPECTED_P);
+
+        // The order is the same as when the sweep is serial
+        for (size_t i = 0; i < output_profile.len; i++) {
+            benchmark_profile_entry_t *entry = &output_profile.entries[i];
+            ASSERT(entry->params.dimensions == serial_profile.entries[i].params.dimensions);
+            ASSERT(memcmp(entry->params.values, serial_profile.entries[i].params.values,
+                          sizeof(*entry->params.values) * entry->params.dimensions) == 0);
+            ASSERT(entry->runs == conf.runs_to_average);
+            ASSERT(entry->time_stats.max > 0);
+        }
+
+        free_benchmark_profile(&output_profile);
+    }
+
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    free_benchmark_profile(&serial_profile);
+    return 1;
+}
+
+#define SCHEDULE_ENTRIES 3
+#define SCHEDULE_RUNS 4
+#define SCHEDULE_BLOCK 2
+
+static double example_schedule_calls[SCHEDULE_ENTRIES * SCHEDULE_RUNS];
+static size_t example_schedule_calls_len;
+
+// Records the order that the entries are run in
+static int example_func_schedule(vector_t params)
+{
+    if (example_schedule_calls_len < SCHEDULE_ENTRIES * SCHEDULE_RUNS) {
+        example_schedule_calls[example_schedule_calls_len] = params.values[0];
+    }
+    example_schedule_calls_len++;
+    return 1;
+}
+
+static int test_schedule_bench_p()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.function_type = FUNC_PARAM;
+    conf.p_func = &example_func_schedule;
+    conf.runs_to_average = SCHEDULE_RUNS;
+    conf.schedule_conf.block_runs = SCHEDULE_BLOCK;
+    range_t entries = range_integer(0, SCHEDULE_ENTRIES - 1, 1);
+    ASSERT(init_multi_dimensional_range_arr(&conf.param_conf.params_generator, 1, &entries));
+
+    // Interleaved blocks go through the entries in order each round
+    conf.schedule_conf.order = SCHEDULE_INTERLEAVED;
+    example_schedule_calls_len = 0;
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == SCHEDULE_ENTRIES);
+    ASSERT(example_schedule_calls_len == SCHEDULE_ENTRIES * SCHEDULE_RUNS);
+    for (size_t i = 0; i < SCHEDULE_ENTRIES * SCHEDULE_RUNS; i++) {
+        ASSERT(example_schedule_calls[i] == (i / SCHEDULE_BLOCK) % SCHEDULE_ENTRIES);
+    }
+    for (size_t i = 0; i < output_profile.len; i++) {
+        ASSERT(output_profile.entries[i].params.values[0] == i);
+        ASSERT(output_profile.entries[i].runs == SCHEDULE_RUNS);
+        ASSERT(output_profile.entries[i].run_times_len == SCHEDULE_RUNS);
+    }
+    free_benchmark_profile(&output_profile);
+
+    // Shuffled blocks still give each entry all of its runs, in blocks
+    conf.schedule_conf.order = SCHEDULE_SHUFFLED;
+    conf.schedule_conf.seed = 42;
+    example_schedule_calls_len = 0;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(example_schedule_calls_len == SCHEDULE_ENTRIES * SCHEDULE_RUNS);
+    size_t calls[SCHEDULE_ENTRIES] = {0};
+    for (size_t i = 0; i < SCHEDULE_ENTRIES * SCHEDULE_RUNS; i += SCHEDULE_BLOCK) {
+        ASSERT(example_schedule_calls[i] == example_schedule_calls[i + 1]);
+        calls[(size_t) example_schedule_calls[i]] += SCHEDULE_BLOCK;
+    }
+    for (size_t i = 0; i < SCHEDULE_ENTRIES; i++) {
+        ASSERT(calls[i] == SCHEDULE_RUNS);
+        ASSERT(output_profile.entries[i].runs == SCHEDULE_RUNS);
+    }
+    free_benchmark_profile(&output_profile);
+
+    // Adaptive run counts stop each entry separately
+    conf.adaptive_conf = (benchmark_adaptive_conf_t) DEFAULT_BENCHMARK_ADAPTIVE_CONF;
+    conf.adaptive_conf.min_runs = 10;
+    conf.adaptive_conf.max_runs = 20;
+    conf.adaptive_conf.target_rel_ci = 0;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    for (size_t i = 0; i < output_profile.len; i++) {
+        ASSERT(output_profile.entries[i].runs == 20);
+        ASSERT(!output_profile.entries[i].converged);
+    }
+    free_benchmark_profile(&output_profile);
+
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
+static atomic_size_t example_counter;
+
+// A contended counter, this should not scale well
+static int example_func_parallel(size_t thread, size_t threads)
+{
+    for (size_t i = 0; i < 100; i++) {
+        atomic_fetch_add(&example_counter, 1);
+    }
+    return thread < threads;
+}
+
+/// Fixtures cannot be used with FUNC_PARALLEL so this is never called
+static void example_run_teardown(void *ctx, vector_t params)
+{
+}
+
+#define MAX_THREADS 4
+
+static int test_scaling_bench()
+{
+    benchmark_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.runs_to_average = 100;
+    conf.function_type = FUNC_PARALLEL;
+    conf.par_func = &example_func_parallel;
+    conf.monitor_func_output = 1;
+    conf.thread_conf.threads = range_linear(1, MAX_THREADS, 1);
+
+    atomic_store(&example_counter, 0);
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == MAX_THREADS);
+
+    size_t calls = 0;
+    for (size_t i = 0; i < output_profile.len; i++) {
+        benchmark_profile_entry_t *entry = &output_profile.entries[i];
+        size_t threads = i + 1;
+        calls += threads * conf.runs_to_average;
+
+        lprintf(LOG_INFO, "%lu threads: %lf calls/s, %lf speedup, %lf efficiency\n", threads,
+                entry->scaling.throughput, entry->scaling.speedup, entry->scaling.efficiency);
+        ASSERT(entry->params.dimensions == 1);
+        ASSERT(entry->params.values[0] == threads);
+        ASSERT(entry->scaling.threads == threads);
+        ASSERT(entry->runs == threads * conf.runs_to_average);
+        ASSERT(entry->scaling.wall_time_ns > 0);
+        ASSERT(entry->scaling.throughput > 0);
+        ASSERT(entry->run_times_len == entry->runs);
+        ASSERT(entry->run_outputs_len == entry->runs);
+        for (size_t j = 0; j < entry->run_outputs_len; j++) {
+            ASSERT(entry->run_outputs[j] == 1);
+        }
+    }
+    ASSERT(output_profile.entries[0].scaling.speedup == 1);
+    ASSERT(output_profile.entries[0].scaling.efficiency == 1);
+    ASSERT(atomic_load(&example_counter) == calls * 100);
+    free_benchmark_profile(&output_profile);
+
+    // The settings that the threads cannot use fail instead of being ignored
+    conf.adaptive_conf.enabled = 1;
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    free_benchmark_profile(&output_profile);
+    conf.adaptive_conf.enabled = 0;
+
+    conf.warmup_conf.until_steady = 1;
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    free_benchmark_profile(&output_profile);
+    conf.warmup_conf.until_steady = 0;
+
+    conf.cold_conf.enabled = 1;
+    conf.cold_conf.flush_size = 1024;
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    free_benchmark_profile(&output_profile);
+    conf.cold_conf.enabled = 0;
+
+    conf.fixture_conf.run_teardown = &example_run_teardown;
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 0);
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+static int test_perf_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.runs_to_average = 10;
+    conf.perf_conf.enabled = 1;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 1);
+
+    benchmark_perf_t *perf = &output_profile.entries->perf;
+    lprintf(LOG_INFO, "example_func_np has %lf IPC\n", perf->ipc);
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        if (!(perf->available & (1 << i))) {
+            ASSERT(perf->counters[i] == 0);
+        }
+    }
+    if (perf->available & (1 << PERF_INSTRUCTIONS)) {
+        ASSERT(perf->counters[PERF_INSTRUCTIONS] > 0);
+    }
+
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+// Stops the compiler from removing malloc and, free pairs
+static void *volatile alloc_sink;
+
+static int example_func_alloc()
+{
+    void *a = alloc_sink = malloc(1000);
+    void *b = alloc_sink = malloc(2000);
+    free(a);
+    free(b);
+    return 1;
+}
+
+static int test_alloc_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.np_func = &example_func_alloc;
+    conf.runs_to_average = 10;
+    conf.alloc_conf.enabled = 1;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 1);
+
+    benchmark_alloc_t *allocs = &output_profile.entries->allocs;
+    if (alloc_tracker_available()) {
+        ASSERT(allocs->allocations == 2);
+        ASSERT(allocs->frees == 2);
+        ASSERT(allocs->total_bytes == 3000);
+        ASSERT(allocs->peak_bytes >= 3000);
+        ASSERT(allocs->size_classes[alloc_size_class(1000)] == 1);
+        ASSERT(allocs->size_classes[alloc_size_class(2000)] == 1);
+    } else {
+        ASSERT(allocs->allocations == 0);
+    }
+
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+#define FIXTURE_SIZE (1 << 20)
+
+typedef struct fixture_ctx_t {
+    size_t setups;
+    size_t teardowns;
+    size_t run_setups;
+    size_t run_teardowns;
+    unsigned char *input;
+    unsigned char *scratch;
+} fixture_ctx_t;
+
+static int fixture_setup(void *ctx_raw, vector_t params)
+{
+    fixture_ctx_t *ctx = ctx_raw;
+    ctx->setups++;
+    ctx->input = malloc(FIXTURE_SIZE);
+    if (ctx->input == NULL) {
+        return 0;
+    }
+    memset(ctx->input, (int) params.values[0], FIXTURE_SIZE);
+    return 1;
+}
+
+static void fixture_teardown(void *ctx_raw, vector_t params)
+{
+    fixture_ctx_t *ctx = ctx_raw;
+    ctx->teardowns++;
+    free(ctx->input);
+    ctx->input = NULL;
+}
+
+static int fixture_run_setup(void *ctx_raw, vector_t params)
+{
+    fixture_ctx_t *ctx = ctx_raw;
+    ctx->run_setups++;
+    ctx->scratch = alloc_sink = malloc(FIXTURE_SIZE);
+    return ctx->scratch != NULL;
+}
+
+static void fixture_run_teardown(void *ctx_raw, vector_t params)
+{
+    fixture_ctx_t *ctx = ctx_raw;
+    ctx->run_teardowns++;
+    free(ctx->scratch);
+    ctx->scratch = NULL;
+}
+
+static int fixture_func(void *ctx_raw, vector_t params)
+{
+    fixture_ctx_t *ctx = ctx_raw;
+    if (ctx->input == NULL || ctx->scratch == NULL) {
+        return 0;
+    }
+    memcpy(ctx->scratch, ctx->input, 1024);
+    return ctx->scratch[0] == params.values[0];
+}
+
+static int test_fixture_bench_p()
+{
+    fixture_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    range_t range = range_linear(1, 3, 1);
+    benchmark_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.runs_to_average = 10;
+    conf.warmup_conf.runs = 2;
+    conf.function_type = FUNC_PARAM;
+    conf.monitor_func_output = 1;
+    conf.alloc_conf.enabled = 1;
+    conf.fixture_conf.ctx = &ctx;
+    conf.fixture_conf.func = &fixture_func;
+    conf.fixture_conf.setup = &fixture_setup;
+    conf.fixture_conf.teardown = &fixture_teardown;
+    conf.fixture_conf.run_setup = &fixture_run_setup;
+    conf.fixture_conf.run_teardown = &fixture_run_teardown;
+    ASSERT(init_multi_dimensional_range_arr(&conf.param_conf.params_generator, 1, &range));
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 3);
+    ASSERT(ctx.setups == 3);
+    ASSERT(ctx.teardowns == 3);
+    ASSERT(ctx.run_setups == 3 * (10 + 2));
+    ASSERT(ctx.run_teardowns == ctx.run_setups);
+
+    // The allocations of the fixture are not in the runs
+    for (size_t i = 0; i < output_profile.len; i++) {
+        benchmark_profile_entry_t *entry = &output_profile.entries[i];
+        ASSERT(entry->run_outputs_len == 10);
+        for (size_t j = 0; j < entry->run_outputs_len; j++) {
+            ASSERT(entry->run_outputs[j] == 1);
+        }
+        ASSERT(entry->allocs.allocations == 0);
+        ASSERT(entry->allocs.total_bytes == 0);
+    }
+    free_benchmark_profile(&output_profile);
+
+    // Interleaved sweeps set up each block of runs
+    memset(&ctx, 0, sizeof(ctx));
+    conf.schedule_conf.order = SCHEDULE_INTERLEAVED;
+    conf.schedule_conf.block_runs = 5;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(ctx.setups == ctx.teardowns);
+    ASSERT(ctx.setups == 3 * 2);
+    ASSERT(output_profile.entries[2].run_outputs[9] == 1);
+    free_benchmark_profile(&output_profile);
+
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
+static int example_func_batch(void *ctx, vector_t params, size_t iterations)
+{
+    // Without the barrier the loop would be folded into one multiply
+    size_t x = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        x += i;
+        BENCHMARK_DO_NOT_OPTIMIZE(x);
+    }
+    return 1;
+}
+
+static int test_batch_bench_np()
+{
+    benchmark_conf_t conf = get_conf_np();
+    conf.runs_to_average = 20;
+    conf.batch_conf.enabled = 1;
+    conf.batch_conf.func = &example_func_batch;
+    conf.batch_conf.target_ns = 100000;
+
+    // The batch is grown until a run takes about 100us, each iteration takes a few ns
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 1);
+    benchmark_profile_entry_t *entry = output_profile.entries;
+    lprintf(LOG_INFO, "Batches of %lu take %lf ns per iteration\n", entry->batch_iterations, entry->op_time_ns);
+    ASSERT(entry->runs == 20);
+    ASSERT(entry->batch_iterations > 100);
+    ASSERT(entry->op_time_ns > 0);
+    ASSERT(entry->op_time_ns < 1000);
+
+    // The run times are of the whole batch so an iteration under a ns is not rounded away
+    ASSERT(entry->run_times_len == 20);
+    ASSERT(entry->time_stats.min > 0);
+    ASSERT(fabs(entry->time_stats.mean / entry->batch_iterations - entry->op_time_ns) < 0.01);
+    free_benchmark_profile(&output_profile);
+
+    // A set number of iterations is used as it is
+    conf.batch_conf.iterations = 1000;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.entries->batch_iterations == 1000);
+    free_benchmark_profile(&output_profile);
+
+    // The function has to be set
+    conf.batch_conf.func = NULL;
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+/// Sums a buffer of v[0] KiB, reporting each byte as an item
+static int example_func_throughput(vector_t v)
+{
+    size_t len = v.values[0] * 1024;
+    unsigned char buffer[len];
+    memset(buffer, 1, len);
+    BENCHMARK_CLOBBER_MEMORY();
+
+    size_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += buffer[i];
+    }
+    BENCHMARK_DO_NOT_OPTIMIZE(sum);
+    benchmark_report_items(sum);
+    return 1;
+}
+
+static size_t throughput_bytes_calls;
+
+static double example_throughput_bytes(vector_t v)
+{
+    throughput_bytes_calls++;
+    return v.values[0] * 1024;
+}
+
+static int test_throughput_bench_p()
+{
+    range_t range = range_linear(1, 4, 1);
+    benchmark_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.runs_to_average = 20;
+    conf.function_type = FUNC_PARAM;
+    conf.p_func = &example_func_throughput;
+    conf.throughput_conf.bytes = &example_throughput_bytes;
+    ASSERT(init_multi_dimensional_range_arr(&conf.param_conf.params_generator, 1, &range));
+
+    // The bytes are from the params and, the items are reported by the function. The bytes are
+    // found once per entry instead of in each run
+    throughput_bytes_calls = 0;
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 4);
+    ASSERT(throughput_bytes_calls == 4);
+    for (size_t i = 0; i < output_profile.len; i++) {
+        benchmark_profile_entry_t *entry = &output_profile.entries[i];
+        lprintf(LOG_INFO, "%lf KiB at %lf GB/s, %lf ns per item\n", entry->params.values[0],
+                entry->gb_per_s, entry->ns_per_item);
+        ASSERT(entry->bytes_per_op == (i + 1) * 1024);
+        ASSERT(entry->items_per_op == (i + 1) * 1024);
+        ASSERT(entry->gb_per_s > 0);
+        ASSERT(fabs(entry->gb_per_s - entry->bytes_per_op / entry->op_time_ns) < 1e-9);
+        ASSERT(fabs(entry->items_per_s * entry->ns_per_item - 1e9) < 1e-3);
+    }
+    free_benchmark_profile(&output_profile);
+
+    // Nothing is known without either
+    conf.throughput_conf.bytes = NULL;
+    conf.p_func = &example_func_p;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.entries[0].bytes_per_op == 0);
+    ASSERT(output_profile.entries[0].gb_per_s == 0);
+    ASSERT(output_profile.entries[0].ns_per_item == 0);
+    free_benchmark_profile(&output_profile);
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
+static int test_barrier()
+{
+    // The values go through the barriers unchanged
+    int x = 42;
+    BENCHMARK_DO_NOT_OPTIMIZE(x);
+    ASSERT(x == 42);
+    BENCHMARK_CONSUME(x * 2);
+    BENCHMARK_CLOBBER_MEMORY();
+    benchmark_escape(&x);
+    ASSERT(x == 42);
+
+    // Every byte is read into the sink
+    unsigned char buffer[4] = {1, 2, 3, 4};
+    uint64_t sink = benchmark_black_hole_sink;
+    benchmark_black_hole(buffer, sizeof(buffer));
+    ASSERT(benchmark_black_hole_sink == sink + 10);
+    benchmark_black_hole(NULL, 0);
+    ASSERT(benchmark_black_hole_sink == sink + 10);
+    return 1;
+}
+
+/// Crashes for 2, hangs for 3 and, is quick otherwise
+static int example_func_isolated(vector_t v)
+{
+    if (v.values[0] == 2) {
+        raise(SIGSEGV);
+    }
+    while (v.values[0] == 3) {
+        sleep(1);
+    }
+    return 1;
+}
+
+static int test_isolated_bench_p()
+{
+    range_t range = range_linear(1, 4, 1);
+    benchmark_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.runs_to_average = 10;
+    conf.function_type = FUNC_PARAM;
+    conf.p_func = &example_func_isolated;
+    conf.monitor_func_output = 1;
+    conf.mem_conf.enabled = 1;
+    conf.isolation_conf.enabled = 1;
+    conf.isolation_conf.timeout_ms = 200;
+    ASSERT(init_multi_dimensional_range_arr(&conf.param_conf.params_generator, 1, &range));
+
+    // The crash and, the hang are recorded and, the sweep carries on
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 4);
+
+    benchmark_profile_entry_t *entries = output_profile.entries;
+    ASSERT(entries[1].status == ENTRY_CRASHED);
+    ASSERT(entries[1].signal == SIGSEGV);
+    ASSERT(entries[1].runs == 0);
+    ASSERT(entries[2].status == ENTRY_TIMED_OUT);
+    ASSERT(entries[2].params.values[0] == 3);
+    for (size_t i = 0; i < 4; i += 3) {
+        ASSERT(entries[i].status == ENTRY_OK);
+        ASSERT(entries[i].params.values[0] == i + 1);
+        ASSERT(entries[i].runs == 10);
+        ASSERT(entries[i].run_outputs_len == 10);
+        ASSERT(entries[i].run_outputs[9] == 1);
+        ASSERT(entries[i].run_times_len == 10);
+    }
+
+    // The signal is next to the status in CSV files
+    benchmark_output_conf_t o_conf;
+    ASSERT(init_benchmark_output_conf(&o_conf, OUTPUT_CSV, "test_isolated_bench_p"));
+    ASSERT(save_benchmark(&output_profile, &o_conf));
+    free_benchmark_output_conf(&o_conf);
+
+    FILE *f = fopen("test_isolated_bench_p.bench.csv", "r");
+    ASSERT(f != NULL);
+    char expected[32], line[4096];
+    snprintf(expected, sizeof(expected), ",crashed,%d,", SIGSEGV);
+    int found = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        found |= strstr(line, expected) != NULL;
+    }
+    fclose(f);
+    remove("test_isolated_bench_p.bench.csv");
+    ASSERT(found);
+
+    free_benchmark_profile(&output_profile);
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
 static int test_output_monitor_bench_p()
 {
     benchmark_conf_t conf = get_conf_p();
@@ -237,5 +1017,22 @@ SUB_TEST(test_bench, {&test_cpu_time_bench_np, "Test CPU time bench NO PARAMS"},
 {&test_output_conf, "Test output conf init and free"},
 {&test_mem_profiler_bench_p_0, "Test  memory profiler PARAMS no alloc"},
 {&test_mem_profiler_bench_np_0, "Test memory profiler NO PARAMS no alloc"},
+{&test_cpu_profiler_bench_np, "Test cpu profiler NO PARAMS"},
+{&test_ns_timer_bench_np, "Test ns timers NO PARAMS"},
+{&test_time_stats_bench_p, "Test run time statistics PARAMS"},
+{&test_adaptive_bench_np, "Test adaptive run count NO PARAMS"},
+{&test_adaptive_time_budget_bench_p, "Test adaptive run count time budget PARAMS"},
+{&test_warmup_bench_np, "Test warm up NO PARAMS"},
+{&test_cold_bench_np, "Test cold runs NO PARAMS"},
+{&test_parallel_bench_p, "Test parallel sweep PARAMS"},
+{&test_schedule_bench_p, "Test interleaved and, shuffled run order PARAMS"},
+{&test_scaling_bench, "Test thread scaling PARALLEL"},
+{&test_perf_bench_np, "Test perf counters NO PARAMS"},
+{&test_alloc_bench_np, "Test allocation tracking NO PARAMS"},
+{&test_fixture_bench_p, "Test fixtures PARAMS"},
+{&test_batch_bench_np, "Test batches NO PARAMS"},
+{&test_barrier, "Test optimisation barriers"},
+{&test_throughput_bench_p, "Test throughput PARAMS"},
+{&test_isolated_bench_p, "Test isolated entries PARAMS"},
 {&test_output_monitor_bench_p, "Test output moinitoring PARAMS"},
 {&test_output_monitor_bench_np, "Test output monitoring NO PARAMS"})
@@ -0,0 +1,187 @@
+#include "./testing.h/testing.h"
+#include "./test_bench_compare.h"
+#include "./bench_compare.h"
+#include "./bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 200
+
+static int test_mann_whitney()
+{
+    uint64_t a[SAMPLES], b[SAMPLES], c[SAMPLES];
+    srand(1);
+    for (size_t i = 0; i < SAMPLES; i++) {
+        a[i] = 1000 + rand() % 100;
+        b[i] = 1000 + rand() % 100;
+        c[i] = 1100 + rand() % 100;
+    }
+
+    // The same distribution is not significant, a 10% shift is
+    ASSERT(mann_whitney_u_test(a, SAMPLES, b, SAMPLES) > 0.01);
+    ASSERT(mann_whitney_u_test(a, SAMPLES, c, SAMPLES) < 1e-6);
+    ASSERT(mann_whitney_u_test(a, SAMPLES, a, SAMPLES) > 0.99);
+    ASSERT(mann_whitney_u_test(a, 0, b, SAMPLES) == 1);
+
+    // All ties
+    uint64_t d[SAMPLES];
+    for (size_t i = 0; i < SAMPLES; i++) {
+        d[i] = 5;
+    }
+    ASSERT(mann_whitney_u_test(d, SAMPLES, d, SAMPLES) == 1);
+    return 1;
+}
+
+/// Makes results with a single param each, the samples of entry i are scaled by scales[i]
+static int make_results(benchmark_results_t *results, double *scales, size_t len)
+{
+    results->len = len;
+    results->entries = calloc(len, sizeof(*results->entries));
+    ASSERT(results->entries != NULL);
+    for (size_t i = 0; i < len; i++) {
+        benchmark_result_t *result = &results->entries[i];
+        result->params.dimensions = 1;
+        result->params.values = malloc(sizeof(double));
+        ASSERT(result->params.values != NULL);
+        result->params.values[0] = i;
+
+        result->samples_len = SAMPLES;
+        result->samples_ns = malloc(sizeof(uint64_t) * SAMPLES);
+        ASSERT(result->samples_ns != NULL);
+        for (size_t j = 0; j < SAMPLES; j++) {
+            result->samples_ns[j] = (1000 + rand() % 50) * scales[i];
+        }
+        result->runs = SAMPLES;
+        result->median_ns = 1025 * scales[i];
+    }
+    return 1;
+}
+
+static int test_compare_results()
+{
+    srand(2);
+    double base_scales[] = {1, 1, 1, 1};
+    double cand_scales[] = {1, 1.1, 0.9, 1.01};
+
+    benchmark_results_t baseline, candidate;
+    ASSERT(make_results(&baseline, base_scales, 4));
+    ASSERT(make_results(&candidate, cand_scales, 3));
+
+    benchmark_compare_conf_t conf;
+    init_benchmark_compare_conf(&conf);
+    benchmark_compare_t compare;
+    ASSERT(compare_benchmark_results(&baseline, &candidate, &conf, &compare));
+    ASSERT(compare.len == 3);
+    ASSERT(compare.unmatched == 1);
+    ASSERT(compare.regressions == 1);
+    ASSERT(compare.improvements == 1);
+    ASSERT(compare.entries[0].verdict == VERDICT_SAME);
+    ASSERT(compare.entries[1].verdict == VERDICT_SLOWER);
+    ASSERT(compare.entries[2].verdict == VERDICT_FASTER);
+    free_benchmark_compare(&compare);
+
+    // A 1% change is under the threshold even when it is significant
+    free_benchmark_results(&candidate);
+    ASSERT(make_results(&candidate, cand_scales + 3, 1));
+    candidate.entries[0].params.values[0] = 0;
+    ASSERT(compare_benchmark_results(&baseline, &candidate, &conf, &compare));
+    ASSERT(compare.len == 1);
+    ASSERT(compare.regressions == 0);
+    free_benchmark_compare(&compare);
+
+    // An entry that crashed has no runs so it cannot be tested, even with a large change
+    candidate.entries[0].runs = 0;
+    candidate.entries[0].samples_len = 0;
+    candidate.entries[0].median_ns = 0;
+    ASSERT(compare_benchmark_results(&baseline, &candidate, &conf, &compare));
+    ASSERT(compare.len == 1);
+    ASSERT(compare.untested == 1);
+    ASSERT(compare.improvements == 0);
+    ASSERT(compare.entries[0].verdict == VERDICT_UNTESTED);
+    free_benchmark_compare(&compare);
+
+    // Batches are compared per iteration, twice the iterations in twice the time is the same
+    free_benchmark_results(&candidate);
+    ASSERT(make_results(&candidate, cand_scales, 1));
+    candidate.entries[0].iterations = 2;
+    for (size_t i = 0; i < SAMPLES; i++) {
+        candidate.entries[0].samples_ns[i] = baseline.entries[0].samples_ns[i] * 2;
+    }
+    candidate.entries[0].median_ns = baseline.entries[0].median_ns * 2;
+    ASSERT(compare_benchmark_results(&baseline, &candidate, &conf, &compare));
+    ASSERT(compare.len == 1);
+    ASSERT(compare.entries[0].candidate_ns == compare.entries[0].baseline_ns);
+    ASSERT(compare.entries[0].p_value > 0.99);
+    ASSERT(compare.entries[0].verdict == VERDICT_SAME);
+    free_benchmark_compare(&compare);
+
+    free_benchmark_results(&baseline);
+    free_benchmark_results(&candidate);
+    return 1;
+}
+
+static int example_func(vector_t v)
+{
+    volatile int x = 0;
+    for (int i = 0; i < 100 * v.values[0]; i++) {
+        x += i;
+    }
+    return x;
+}
+
+/// Each output type of the same profile loads to the same entries and, has no regressions
+static int test_load_results()
+{
+    range_t range = range_linear(1, 4, 1);
+    benchmark_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.runs_to_average = 50;
+    conf.function_type = FUNC_PARAM;
+    conf.p_func = &example_func;
+    init_multi_dimensional_range_arr(&conf.param_conf.params_generator, 1, &range);
+
+    benchmark_profile_t profile;
+    ASSERT(benchmark_program(&conf, &profile));
+    ASSERT(profile.len == 4);
+
+    benchmark_output_type_t types[] = {OUTPUT_JSON, OUTPUT_NDJSON, OUTPUT_CSV, OUTPUT_BINARY};
+    const char *files[] = {"test_load_results.bench.json", "test_load_results.bench.ndjson",
+                           "test_load_results.bench.csv", "test_load_results.bench.bin"
+                          };
+    for (size_t i = 0; i < sizeof(types) / sizeof(*types); i++) {
+        benchmark_output_conf_t o_conf;
+        ASSERT(init_benchmark_output_conf(&o_conf, types[i], "test_load_results"));
+        ASSERT(save_benchmark(&profile, &o_conf));
+        free_benchmark_output_conf(&o_conf);
+
+        benchmark_results_t results;
+        ASSERT(load_benchmark_results(&results, files[i]));
+        ASSERT(results.len == profile.len);
+        for (size_t j = 0; j < results.len; j++) {
+            ASSERT(results.entries[j].params.dimensions == 1);
+            ASSERT(results.entries[j].params.values[0] == profile.entries[j].params.values[0]);
+            ASSERT(results.entries[j].runs == profile.entries[j].runs);
+            ASSERT(results.entries[j].samples_len == (types[i] == OUTPUT_CSV ? 0 : profile.entries[j].run_times_len));
+        }
+
+        benchmark_compare_conf_t cmp_conf;
+        init_benchmark_compare_conf(&cmp_conf);
+        benchmark_compare_t compare;
+        ASSERT(compare_benchmark_results(&results, &results, &cmp_conf, &compare));
+        ASSERT(compare.len == profile.len);
+        ASSERT(compare.regressions == 0);
+        free_benchmark_compare(&compare);
+        free_benchmark_results(&results);
+    }
+
+    benchmark_results_t results;
+    ASSERT(!load_benchmark_results(&results, "test_load_results.bench.txt"));
+
+    free_benchmark_profile(&profile);
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
+SUB_TEST(test_bench_compare, {&test_mann_whitney, "Test Mann-Whitney U test"},
+{&test_compare_results, "Test comparing results"},
+{&test_load_results, "Test loading saved results"})
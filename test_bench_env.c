@@ -0,0 +1,108 @@
+#include "./testing.h/testing.h"
+#include "./test_bench_env.h"
+#include "./bench.h"
+#include <string.h>
+
+static int test_capture_env()
+{
+    benchmark_env_t env;
+    ASSERT(capture_benchmark_env(&env));
+    ASSERT(!capture_benchmark_env(NULL));
+    lprintf(LOG_INFO, "%s on %s (%s), governor %s, turbo %d, smt %d, aslr %d\n", env.cpu_model, env.kernel,
+            env.hostname, env.governor, env.turbo, env.smt, env.aslr);
+
+    ASSERT(env.captured);
+    ASSERT(env.timestamp > 0);
+    ASSERT(env.cpus > 0);
+    ASSERT(strlen(env.cpu_model) > 0);
+    ASSERT(strlen(env.kernel) > 0);
+    ASSERT(strcmp(env.git_commit, GIT_COMMIT_HASH) == 0);
+    ASSERT(strcmp(env.version, VERSION) == 0);
+    return 1;
+}
+
+static int test_preflight()
+{
+    // A quiet machine passes a strict check
+    benchmark_env_t env;
+    memset(&env, 0, sizeof(env));
+    env.cpus = 4;
+    env.load_avg[0] = 0.5;
+    strcpy(env.governor, "performance");
+    env.turbo = 0;
+    env.aslr = 0;
+
+    benchmark_preflight_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.enabled = 1;
+    conf.strict = 1;
+    ASSERT(benchmark_preflight(&env, &conf));
+
+    // Settings that cannot be read are not problems
+    strcpy(env.governor, "unknown");
+    env.turbo = BENCHMARK_ENV_UNKNOWN;
+    env.aslr = BENCHMARK_ENV_UNKNOWN;
+    ASSERT(benchmark_preflight(&env, &conf));
+
+    // Each noisy setting fails it
+    strcpy(env.governor, "powersave");
+    ASSERT(!benchmark_preflight(&env, &conf));
+    strcpy(env.governor, "performance");
+
+    env.load_avg[0] = 2;
+    ASSERT(!benchmark_preflight(&env, &conf));
+    conf.max_load = 1;
+    ASSERT(benchmark_preflight(&env, &conf));
+
+    env.aslr = 2;
+    ASSERT(!benchmark_preflight(&env, &conf));
+    env.aslr = 0;
+
+    env.turbo = 1;
+    ASSERT(!benchmark_preflight(&env, &conf));
+
+    // Or only warns
+    conf.strict = 0;
+    ASSERT(benchmark_preflight(&env, &conf));
+    return 1;
+}
+
+static int example_func_preflight()
+{
+    return 1;
+}
+
+static int test_preflight_bench_np()
+{
+    benchmark_conf_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.runs_to_average = 10;
+    conf.function_type = FUNC_NO_PARAM;
+    conf.np_func = &example_func_preflight;
+
+    // The environment is captured with the profile
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.env.captured);
+    ASSERT(output_profile.env.cpus > 0);
+    free_benchmark_profile(&output_profile);
+
+    // Nothing is run when a strict check fails, any load is over this limit
+    conf.preflight_conf.enabled = 1;
+    conf.preflight_conf.strict = 1;
+    conf.preflight_conf.max_load = 1e-9;
+    benchmark_env_t env;
+    ASSERT(capture_benchmark_env(&env));
+    if (env.load_avg[0] <= 0) {
+        lprintf(LOG_WARNING, "The machine has no load, skipping\n");
+        return 1;
+    }
+    ASSERT(!benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 0);
+    free_benchmark_profile(&output_profile);
+    return 1;
+}
+
+SUB_TEST(test_bench_env, {&test_capture_env, "Test capturing the environment"},
+{&test_preflight, "Test preflight checks"},
+{&test_preflight_bench_np, "Test preflight before a benchmark NO PARAMS"})
@@ -1,8 +1,12 @@
 #include "./test_bench_output.h"
 #include "./bench.h"
+#include "./bench_output.h"
+#include "./bench_binary.h"
 #include "./testing.h/testing.h"
 #include <math.h>
+#include <jansson.h>
 #include <string.h>
+#include <unistd.h>
 
 static benchmark_output_conf_t get_output_conf_csv(char *prefix)
 {
@@ -18,6 +22,9 @@ static benchmark_output_conf_t get_output_conf_json(char *prefix)
     return ret;
 }
 
+/// The number of columns before run_outputs, without params
+#define CSV_FIXED_COLUMNS 50
+
 // Copied from ./test_bench.c
 #define RUNS_TO_AVERAGE 1000
 
@@ -73,10 +80,9 @@ static benchmark_conf_t get_conf_p()
     multi_dimensional_range_t range;
     memset(&range, 0, sizeof(range));
 
-    range_t range_1, range_2, range_3;
-    range_1.start = range_2.start = range_3.start = 1;
-    range_1.end = range_2.end = range_3.end = 3;
-    range_1.step = range_2.step = range_3.step = 1;
+    range_t range_1 = range_linear(1, 3, 1);
+    range_t range_2 = range_linear(1, 3, 1);
+    range_t range_3 = range_linear(1, 3, 1);
 
     init_multi_dimensional_range(&range, range_1, range_2, range_3);
 
@@ -120,7 +126,12 @@ static int test_csv_output_np()
 
     size_t len = RUNS_TO_AVERAGE * 9 + 100;
     char *buffer = malloc(len);
-    ASSERT(fgets(buffer, len, f) != NULL); // read headers
+    // The environment is in comment lines before the headers
+    ASSERT(fgets(buffer, len, f) != NULL);
+    ASSERT(strncmp(buffer, "# timestamp,", 12) == 0);
+    while (buffer[0] == '#') {
+        ASSERT(fgets(buffer, len, f) != NULL); // read headers
+    }
 
     size_t i = 0;
     while (fgets(buffer, len, f) != NULL) {
@@ -132,7 +143,7 @@ static int test_csv_output_np()
         }
 
         // ASSERT there are enough commas
-        ASSERT(c == 3 + conf.runs_to_average - 1);
+        ASSERT(c == CSV_FIXED_COLUMNS + conf.runs_to_average - 1);
         i++;
     }
     free(buffer);
@@ -168,7 +179,12 @@ static int test_csv_output_p()
 
     size_t len = RUNS_TO_AVERAGE * 9 + 100;
     char *buffer = malloc(len);
-    ASSERT(fgets(buffer, len, f) != NULL); // read headers
+    // The environment is in comment lines before the headers
+    ASSERT(fgets(buffer, len, f) != NULL);
+    ASSERT(strncmp(buffer, "# timestamp,", 12) == 0);
+    while (buffer[0] == '#') {
+        ASSERT(fgets(buffer, len, f) != NULL); // read headers
+    }
 
     size_t i = 0;
     while (fgets(buffer, len, f) != NULL) {
@@ -180,7 +196,7 @@ static int test_csv_output_p()
         }
 
         // ASSERT there are enough commas
-        ASSERT(c == 3 + conf.runs_to_average - 1 + conf.param_conf.params_generator.dimensions);
+        ASSERT(c == CSV_FIXED_COLUMNS + conf.runs_to_average - 1 + conf.param_conf.params_generator.dimensions);
         i++;
     }
     free(buffer);
@@ -209,6 +225,18 @@ static int test_json_output_p()
     benchmark_output_conf_t o_conf = get_output_conf_json("test_json_output_p");
     ASSERT(save_benchmark(&output_profile, &o_conf));
     free_benchmark_output_conf(&o_conf);
+
+    // The entries are saved with the environment
+    json_error_t error;
+    json_t *root = json_load_file("test_json_output_p.bench.json", 0, &error);
+    ASSERT(json_is_object(root));
+    json_t *env = json_object_get(root, "env");
+    ASSERT(json_is_object(env));
+    ASSERT(strcmp(json_string_value(json_object_get(env, "git_commit")), output_profile.env.git_commit) == 0);
+    ASSERT(json_integer_value(json_object_get(env, "cpus")) == output_profile.env.cpus);
+    ASSERT(json_is_array(json_object_get(root, "entries")));
+    ASSERT(json_array_size(json_object_get(root, "entries")) == LEN_EXPECTED_P);
+    json_decref(root);
     free_benchmark_profile(&output_profile);
 
     return 1;
@@ -235,7 +263,215 @@ static int test_json_output_np()
     return 1;
 }
 
+/// The number of lines in a file, -1 if it cannot be read
+static long count_lines(const char *name)
+{
+    FILE *f = fopen(name, "r");
+    if (f == NULL) {
+        return -1;
+    }
+
+    // The comment lines of the environment are not counted
+    long lines = 0;
+    int c, line_start = 1, comment = 0;
+    while ((c = fgetc(f)) != EOF) {
+        if (line_start) {
+            comment = c == '#';
+        }
+        line_start = c == '\n';
+        lines += line_start && !comment;
+    }
+    fclose(f);
+    return lines;
+}
+
+static int test_stream_output_p()
+{
+    benchmark_conf_t conf = get_conf_p();
+    conf.runs_to_average = 10;
+
+    // Entries are written as they finish and, not kept
+    benchmark_output_conf_t o_conf = get_output_conf_csv("test_stream_output_p");
+    conf.stream_conf.output = &o_conf;
+    conf.stream_conf.discard_entries = 1;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == 0);
+    ASSERT(count_lines("test_stream_output_p.bench.csv") == LEN_EXPECTED_P + 1);
+    free_benchmark_profile(&output_profile);
+    free_benchmark_output_conf(&o_conf);
+
+    // NDJSON has a line per entry and, the entries can be kept as well
+    ASSERT(init_benchmark_output_conf(&o_conf, OUTPUT_NDJSON, "test_stream_output_p"));
+    conf.stream_conf.discard_entries = 0;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P);
+    ASSERT(count_lines("test_stream_output_p.bench.ndjson") == LEN_EXPECTED_P);
+
+    FILE *f = fopen("test_stream_output_p.bench.ndjson", "r");
+    ASSERT(f != NULL);
+    ASSERT(fgetc(f) == '{');
+    fclose(f);
+
+    // Saving writes the same lines
+    ASSERT(save_benchmark(&output_profile, &o_conf));
+    ASSERT(count_lines("test_stream_output_p.bench.ndjson") == LEN_EXPECTED_P);
+    free_benchmark_profile(&output_profile);
+    free_benchmark_output_conf(&o_conf);
+
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
+static int test_binary_output_p()
+{
+    benchmark_conf_t conf = get_conf_p();
+    conf.runs_to_average = 10;
+
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P);
+
+    benchmark_output_conf_t o_conf;
+    ASSERT(init_benchmark_output_conf(&o_conf, OUTPUT_BINARY, "test_binary_output_p"));
+    ASSERT(save_benchmark(&output_profile, &o_conf));
+    free_benchmark_output_conf(&o_conf);
+
+    // Every entry reads back the same as it was saved
+    benchmark_binary_t bin;
+    ASSERT(open_benchmark_binary(&bin, "test_binary_output_p.bench.bin"));
+    ASSERT(bin.header->entries == LEN_EXPECTED_P);
+    ASSERT(bin.header->dimensions == 3);
+    ASSERT(bin.header->function_type == FUNC_PARAM);
+    for (size_t i = 0; i < output_profile.len; i++) {
+        benchmark_profile_entry_t *entry = &output_profile.entries[i];
+        benchmark_binary_entry_t bin_entry;
+        ASSERT(benchmark_binary_entry(&bin, i, &bin_entry));
+        ASSERT(memcmp(bin_entry.params, entry->params.values, sizeof(double) * 3) == 0);
+        ASSERT(bin_entry.timing->runs == entry->runs);
+        ASSERT(bin_entry.timing->cpu_time_ns == entry->cpu_time_ns);
+        ASSERT(bin_entry.timing->time_stats.p99 == entry->time_stats.p99);
+        ASSERT(bin_entry.timing->time_stats.mean == entry->time_stats.mean);
+        ASSERT(bin_entry.timing->perf.available == entry->perf.available);
+        ASSERT(bin_entry.memory->max_mem_usage == entry->max_mem_usage);
+        ASSERT(bin_entry.timing->run_times_len == entry->run_times_len);
+        ASSERT(memcmp(bin_entry.run_times_ns, entry->run_times_ns, sizeof(uint64_t) * entry->run_times_len) == 0);
+        ASSERT(bin_entry.timing->run_outputs_len == entry->run_outputs_len);
+        ASSERT(memcmp(bin_entry.run_outputs, entry->run_outputs, sizeof(int) * entry->run_outputs_len) == 0);
+        for (size_t j = 0; j < bin.header->cpu_cores; j++) {
+            ASSERT(bin_entry.cpu_core_usage_us[j] == entry->cpu_core_usage_us[j]);
+        }
+    }
+
+    benchmark_binary_entry_t bin_entry;
+    ASSERT(!benchmark_binary_entry(&bin, LEN_EXPECTED_P, &bin_entry));
+    close_benchmark_binary(&bin);
+
+    // A cut off file is not read
+    ASSERT(truncate("test_binary_output_p.bench.bin", 100) == 0);
+    ASSERT(!open_benchmark_binary(&bin, "test_binary_output_p.bench.bin"));
+
+    free_benchmark_profile(&output_profile);
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
+static long line_offset(const char *name, long lines)
+{
+    FILE *f = fopen(name, "r");
+    if (f == NULL) {
+        return -1;
+    }
+
+    int c, line_start = 1, comment = 0;
+    while (lines > 0 && (c = fgetc(f)) != EOF) {
+        if (line_start) {
+            comment = c == '#';
+        }
+        line_start = c == '\n';
+        lines -= line_start && !comment;
+    }
+    long offset = ftell(f);
+    fclose(f);
+    return offset;
+}
+
+#define RESUME_FROM 5
+
+static int test_checkpoint_output_p()
+{
+    benchmark_conf_t conf = get_conf_p();
+    conf.runs_to_average = 10;
+
+    benchmark_output_conf_t o_conf = get_output_conf_csv("test_checkpoint_output_p");
+    conf.stream_conf.output = &o_conf;
+    conf.stream_conf.checkpoint = 1;
+
+    // A finished sweep removes its checkpoint
+    benchmark_profile_t output_profile;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P);
+    ASSERT(access("test_checkpoint_output_p.bench.csv.ckpt", F_OK) != 0);
+    free_benchmark_profile(&output_profile);
+
+    // Make it look like the sweep was stopped while the entry after RESUME_FROM was being written
+    benchmark_checkpoint_t ckpt;
+    ckpt.fingerprint = benchmark_conf_fingerprint(&conf);
+    ckpt.next_index = RESUME_FROM;
+    ckpt.entries = RESUME_FROM;
+    ckpt.output_offset = line_offset("test_checkpoint_output_p.bench.csv", RESUME_FROM + 1);
+    ASSERT(ckpt.output_offset > 0);
+    ASSERT(truncate("test_checkpoint_output_p.bench.csv", ckpt.output_offset + 3) == 0);
+    ASSERT(write_benchmark_checkpoint(&o_conf, &ckpt));
+
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P - RESUME_FROM);
+    ASSERT(count_lines("test_checkpoint_output_p.bench.csv") == LEN_EXPECTED_P + 1);
+    ASSERT(access("test_checkpoint_output_p.bench.csv.ckpt", F_OK) != 0);
+    free_benchmark_profile(&output_profile);
+
+    // A checkpoint for another config is not used
+    ASSERT(write_benchmark_checkpoint(&o_conf, &ckpt));
+    conf.runs_to_average = 5;
+    ASSERT(benchmark_program(&conf, &output_profile));
+    ASSERT(output_profile.len == LEN_EXPECTED_P);
+    ASSERT(count_lines("test_checkpoint_output_p.bench.csv") == LEN_EXPECTED_P + 1);
+    free_benchmark_profile(&output_profile);
+
+    // Nor is one for the same config with other settings that change the entries
+    conf.runs_to_average = 10;
+    uint64_t fingerprint = benchmark_conf_fingerprint(&conf);
+    conf.max_run_times = 3;
+    ASSERT(benchmark_conf_fingerprint(&conf) != fingerprint);
+    conf.max_run_times = 0;
+    conf.isolation_conf.enabled = 1;
+    ASSERT(benchmark_conf_fingerprint(&conf) != fingerprint);
+    conf.isolation_conf.enabled = 0;
+    conf.batch_conf.enabled = 1;
+    ASSERT(benchmark_conf_fingerprint(&conf) != fingerprint);
+    conf.batch_conf.enabled = 0;
+    ASSERT(benchmark_conf_fingerprint(&conf) == fingerprint);
+
+    // The checkpoint of a CSV sweep is not used by an NDJSON sweep with the same prefix
+    ASSERT(write_benchmark_checkpoint(&o_conf, &ckpt));
+    benchmark_output_conf_t ndjson_conf;
+    ASSERT(init_benchmark_output_conf(&ndjson_conf, OUTPUT_NDJSON, "test_checkpoint_output_p"));
+    ASSERT(!read_benchmark_checkpoint(&ndjson_conf, &ckpt));
+    conf.stream_conf.output = &ndjson_conf;
+    ASSERT(benchmark_conf_fingerprint(&conf) != fingerprint);
+    free_benchmark_output_conf(&ndjson_conf);
+    remove("test_checkpoint_output_p.bench.csv.ckpt");
+
+    free_benchmark_output_conf(&o_conf);
+    free_multi_dimensional_range(&conf.param_conf.params_generator);
+    return 1;
+}
+
 SUB_TEST(test_bench_output, {&test_csv_output_np, "Test CSV output NO PARAMS"},
 {&test_csv_output_p, "Test CSV output PARAMS"},
 {&test_json_output_p, "Test JSON output PARAMS"},
-{&test_json_output_np, "Test  JSON output NO PARAMS"})
+{&test_json_output_np, "Test  JSON output NO PARAMS"},
+{&test_stream_output_p, "Test streamed CSV and, NDJSON output PARAMS"},
+{&test_checkpoint_output_p, "Test checkpointed output PARAMS"},
+{&test_binary_output_p, "Test binary output PARAMS"})
@@ -0,0 +1,96 @@
+#include "./testing.h/testing.h"
+#include "./test_bench_registry.h"
+#include "./bench_registry.h"
+#include <string.h>
+#include <unistd.h>
+
+static int registry_np_calls = 0;
+static int registry_p_calls = 0;
+
+static int registry_func_np()
+{
+    registry_np_calls++;
+    return 1;
+}
+
+static int registry_func_p(vector_t v)
+{
+    registry_p_calls++;
+    return 1;
+}
+
+BENCHMARK(registry_np)
+{
+    conf->function_type = FUNC_NO_PARAM;
+    conf->np_func = &registry_func_np;
+    conf->runs_to_average = 10;
+}
+
+BENCHMARK(registry_p)
+{
+    range_t range = range_linear(1, 3, 1);
+    conf->function_type = FUNC_PARAM;
+    conf->p_func = &registry_func_p;
+    conf->runs_to_average = 10;
+    init_multi_dimensional_range_arr(&conf->param_conf.params_generator, 1, &range);
+}
+
+static int test_registry_order()
+{
+    benchmark_registration_t *reg = registered_benchmarks();
+    while (reg != NULL && strcmp(reg->name, "registry_np") != 0) {
+        reg = reg->next;
+    }
+    ASSERT(reg != NULL);
+    ASSERT(reg->next != NULL);
+    ASSERT(strcmp(reg->next->name, "registry_p") == 0);
+    return 1;
+}
+
+static int test_registry_list()
+{
+    benchmark_suite_conf_t conf;
+    init_benchmark_suite_conf(&conf);
+    conf.filter = "^registry_(np|p)$";
+
+    char buffer[BUFFER_LENGTH];
+    memset(buffer, 0, sizeof(buffer));
+    FILE *f = fmemopen(buffer, sizeof(buffer), "w");
+    ASSERT(f != NULL);
+    ASSERT(list_benchmarks(f, &conf));
+    fclose(f);
+    ASSERT(strcmp(buffer, "registry_np\nregistry_p\n") == 0);
+
+    conf.filter = "(";
+    ASSERT(!list_benchmarks(stdout, &conf));
+    return 1;
+}
+
+static int test_registry_run()
+{
+    benchmark_suite_conf_t conf;
+    init_benchmark_suite_conf(&conf);
+    conf.filter = "^registry_";
+    conf.runs = 20;
+    conf.output_type = OUTPUT_CSV;
+    conf.output_prefix = "test_suite_";
+
+    registry_np_calls = registry_p_calls = 0;
+    ASSERT(run_benchmark_suite(&conf));
+    ASSERT(registry_np_calls == 20);
+    ASSERT(registry_p_calls == 3 * 20);
+    ASSERT(access("test_suite_registry_np.bench.csv", F_OK) == 0);
+    ASSERT(access("test_suite_registry_p.bench.csv", F_OK) == 0);
+
+    // Only the matching benchmarks are run
+    conf.filter = "_np$";
+    registry_np_calls = registry_p_calls = 0;
+    ASSERT(run_benchmark_suite(&conf));
+    ASSERT(registry_np_calls == 20);
+    ASSERT(registry_p_calls == 0);
+    return 1;
+}
+
+SUB_TEST(test_bench_registry, {&test_registry_order, "Test registry order"},
+{&test_registry_list, "Test listing benchmarks"},
+{&test_registry_run, "Test running a suite"})
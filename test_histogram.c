@@ -0,0 +1,118 @@
+#include "./testing.h/testing.h"
+#include "./test_histogram.h"
+#include "./histogram.h"
+#include <math.h>
+
+#define VALUES 100000
+#define REL_ERROR (1.0 / HISTOGRAM_SUB_BUCKETS)
+#define NEAR(a, b) (fabs((double) (a) - (double) (b)) <= REL_ERROR * (double) (b) + 1)
+
+static int test_histogram_empty()
+{
+    histogram_t hist;
+    init_histogram(&hist);
+
+    ASSERT(hist.count == 0);
+    ASSERT(histogram_percentile(&hist, 50) == 0);
+    ASSERT(histogram_stddev(&hist) == 0);
+    ASSERT(histogram_mad(&hist) == 0);
+
+    free_histogram(&hist);
+    return 1;
+}
+
+static int test_histogram_percentiles()
+{
+    histogram_t hist;
+    init_histogram(&hist);
+
+    // 1 .. VALUES so that percentile p is about p% of VALUES
+    for (uint64_t i = 1; i <= VALUES; i++) {
+        ASSERT(histogram_record(&hist, i));
+    }
+
+    ASSERT(hist.count == VALUES);
+    ASSERT(hist.min == 1);
+    ASSERT(hist.max == VALUES);
+    ASSERT(fabs(hist.mean - (VALUES + 1) / 2.0) < 0.001);
+
+    ASSERT(NEAR(histogram_percentile(&hist, 50), VALUES / 2));
+    ASSERT(NEAR(histogram_percentile(&hist, 90), VALUES * 9 / 10));
+    ASSERT(NEAR(histogram_percentile(&hist, 99), VALUES * 99 / 100));
+    ASSERT(NEAR(histogram_percentile(&hist, 99.9), VALUES * 999 / 1000));
+    ASSERT(histogram_percentile(&hist, 0) == 1);
+    ASSERT(histogram_percentile(&hist, 100) == VALUES);
+
+    // Uniform distribution on 1 .. n
+    double stddev = sqrt(((double) VALUES * VALUES - 1) / 12.0);
+    ASSERT(fabs(histogram_stddev(&hist) - stddev) < 1);
+
+    // Half of the values are within n / 4 of the median
+    ASSERT(NEAR(histogram_mad(&hist), VALUES / 4));
+
+    reset_histogram(&hist);
+    ASSERT(hist.count == 0);
+    ASSERT(histogram_percentile(&hist, 50) == 0);
+
+    free_histogram(&hist);
+    return 1;
+}
+
+static int test_histogram_large_values()
+{
+    histogram_t hist;
+    init_histogram(&hist);
+
+    uint64_t values[] = {0, 1, 127, 128, 1000, 1000000, 1ULL << 40, UINT64_MAX};
+    for (size_t i = 0; i < sizeof(values) / sizeof(*values); i++) {
+        ASSERT(histogram_record(&hist, values[i]));
+    }
+
+    ASSERT(hist.min == 0);
+    ASSERT(hist.max == UINT64_MAX);
+    ASSERT(histogram_percentile(&hist, 100) == UINT64_MAX);
+    ASSERT(histogram_percentile(&hist, 1) == 0);
+
+    // Exact for small values
+    reset_histogram(&hist);
+    for (size_t i = 0; i < 10; i++) {
+        ASSERT(histogram_record(&hist, 42));
+    }
+    ASSERT(histogram_percentile(&hist, 50) == 42);
+    ASSERT(histogram_mad(&hist) == 0);
+
+    free_histogram(&hist);
+    return 1;
+}
+
+static int test_histogram_merge()
+{
+    histogram_t a, b, all;
+    init_histogram(&a);
+    init_histogram(&b);
+    init_histogram(&all);
+
+    for (uint64_t i = 1; i <= VALUES; i++) {
+        ASSERT(histogram_record(i % 3 == 0 ? &a : &b, i * 7));
+        ASSERT(histogram_record(&all, i * 7));
+    }
+
+    ASSERT(histogram_merge(&a, &b));
+    ASSERT(a.count == all.count);
+    ASSERT(a.min == all.min);
+    ASSERT(a.max == all.max);
+    ASSERT(fabs(a.mean - all.mean) < 0.001);
+    ASSERT(fabs(histogram_stddev(&a) - histogram_stddev(&all)) < 0.001);
+    ASSERT(histogram_percentile(&a, 50) == histogram_percentile(&all, 50));
+    ASSERT(histogram_percentile(&a, 99) == histogram_percentile(&all, 99));
+
+    free_histogram(&a);
+    free_histogram(&b);
+    free_histogram(&all);
+    return 1;
+}
+
+SUB_TEST(test_histogram, {&test_histogram_empty, "Test empty histogram"},
+{&test_histogram_percentiles, "Test histogram percentiles and, deviations"},
+{&test_histogram_large_values, "Test histogram with extreme values"},
+{&test_histogram_merge, "Test merging histograms"})
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 
 #define BLOCKS 1024
 #define BLOCK_SIZE 1024
@@ -11,7 +12,10 @@
 int test_memory_profiler()
 {
     memory_profiler_t mpt;
+    memset(&mpt, 0, sizeof(mpt));
     mpt.poll_time = 1;
+    mpt.sample_rss = 1;
+    mpt.sample_pss = 1;
 
     ASSERT(init_memory_profiler(&mpt));
 
@@ -24,13 +28,36 @@ int test_memory_profiler()
         }
     }
 
-    usleep(mpt.poll_time * 100);
+    // poll_time is in ms, wait for a few polls
+    usleep(mpt.poll_time * 1000 * 10);
     size_t usage = max_mem_usage(&mpt);
     lprintf(LOG_INFO, "Currently using about %lu bytes\n", usage);
     ASSERT(usage >= BLOCKS * BLOCK_SIZE);
 
+    // The blocks were written to so they are resident
+    memory_usage_t mem;
+    memory_profiler_usage(&mpt, &mem);
+    lprintf(LOG_INFO, "rss %lu B, pss %lu B, %lu minor faults, %lu major faults\n",
+            mem.rss, mem.pss, mem.minor_faults, mem.major_faults);
+    ASSERT(mem.heap >= BLOCKS * BLOCK_SIZE);
+    ASSERT(mem.rss >= BLOCKS * BLOCK_SIZE / 2);
+    ASSERT(mem.minor_faults > 0);
+
     calibrate_memory_profiler(&mpt);
     ASSERT(max_mem_usage(&mpt) == 0);
+    memory_profiler_usage(&mpt, &mem);
+    ASSERT(mem.rss == 0);
+
+    // The heap is not polled when it is skipped
+    mpt.skip_heap = 1;
+    calibrate_memory_profiler(&mpt);
+    for (size_t i = 0; i < BLOCKS; i++) {
+        free(blocks[i]);
+        blocks[i] = malloc(2 * BLOCK_SIZE);
+        ASSERT(blocks[i] != NULL);
+    }
+    memory_profiler_usage(&mpt, &mem);
+    ASSERT(mem.heap == 0);
 
     for (size_t i = 0; i < BLOCKS; i++) {
         free(blocks[i]);
@@ -40,3 +67,49 @@ int test_memory_profiler()
 
     return 1;
 }
+
+#define BUSY_TIME_US (250 * 1000)
+
+int test_cpu_profiler()
+{
+    cpu_profiler_t cpt;
+    cpt.poll_time = 10;
+
+    ASSERT(init_cpu_profiler(&cpt));
+    ASSERT(cpt.cores > 0);
+
+    // Spin until this thread has used the cpu time, wall time depends on the load of the system
+    struct timespec start, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    volatile double x = 0;
+    do {
+        for (int i = 0; i < 1000; i++) {
+            x += i;
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < BUSY_TIME_US);
+
+    long usage = cpu_core_time_us(&cpt);
+    lprintf(LOG_INFO, "Used about %lu us of cpu time\n", usage);
+
+    size_t cores[cpt.cores];
+    int read_cores = cpu_per_core_time_us(&cpt, cores);
+    size_t total = 0;
+    for (size_t i = 0; read_cores && i < cpt.cores; i++) {
+        total += cores[i];
+    }
+
+    calibrate_cpu_profiler(&cpt);
+    long calibrated = cpu_core_time_us(&cpt);
+
+    // The profiler is freed before checking so that its thread does not outlive the test
+    free_cpu_profiler(&cpt);
+
+    // The usage is sampled in clock ticks so it can be a tick short
+    ASSERT(usage >= BUSY_TIME_US / 2);
+    ASSERT(read_cores);
+    ASSERT(total >= BUSY_TIME_US / 2);
+    ASSERT(calibrated < BUSY_TIME_US / 2);
+
+    return 1;
+}
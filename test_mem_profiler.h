@@ -1,3 +1,4 @@
 #pragma once
 
 int test_memory_profiler();
+int test_cpu_profiler();
@@ -0,0 +1,71 @@
+#include "./testing.h/testing.h"
+#include "./test_perf_profiler.h"
+#include "./perf_profiler.h"
+
+#define LOOPS 1000000
+
+static int test_perf_profiler_counts()
+{
+    perf_profiler_t ppt;
+    ASSERT(init_perf_profiler(&ppt));
+    lprintf(LOG_INFO, "Perf counters available: %x\n", ppt.available);
+
+    uint64_t counters[PERF_COUNTERS];
+    start_perf_profiler(&ppt);
+    volatile size_t x = 0;
+    for (size_t i = 0; i < LOOPS; i++) {
+        x += i;
+    }
+    ASSERT(stop_perf_profiler(&ppt, counters));
+
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        lprintf(LOG_INFO, "%s: %lu\n", perf_counter_name(i), counters[i]);
+        if (!(ppt.available & (1 << i))) {
+            ASSERT(counters[i] == 0);
+        }
+    }
+    ASSERT((ppt.counted & ~ppt.available) == 0);
+
+    // The software counters are in their own group so they are counted even if the PMU cannot
+    // fit the hardware groups
+    if (ppt.available & (1 << PERF_CONTEXT_SWITCHES)) {
+        ASSERT(ppt.counted & (1 << PERF_CONTEXT_SWITCHES));
+        ASSERT(ppt.leaders[PERF_GROUP_SOFTWARE] >= 0);
+    }
+
+    // The loop must have taken at least one instruction per iteration
+    if (ppt.available & (1 << PERF_INSTRUCTIONS)) {
+        ASSERT(counters[PERF_INSTRUCTIONS] >= LOOPS);
+    }
+    if (ppt.available & (1 << PERF_CYCLES)) {
+        ASSERT(counters[PERF_CYCLES] > 0);
+    }
+
+    free_perf_profiler(&ppt);
+    ASSERT(ppt.available == 0);
+    for (size_t i = 0; i < PERF_GROUPS; i++) {
+        ASSERT(ppt.leaders[i] == -1);
+    }
+    return 1;
+}
+
+static int test_perf_profiler_no_counters()
+{
+    // Stopping a profiler with no counters is a no-op
+    perf_profiler_t ppt;
+    ASSERT(init_perf_profiler(&ppt));
+    free_perf_profiler(&ppt);
+
+    uint64_t counters[PERF_COUNTERS];
+    start_perf_profiler(&ppt);
+    ASSERT(stop_perf_profiler(&ppt, counters));
+    ASSERT(ppt.counted == 0);
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        ASSERT(counters[i] == 0);
+    }
+    ASSERT(perf_counter_name(PERF_COUNTERS)[0] != 0);
+    return 1;
+}
+
+SUB_TEST(test_perf_profiler, {&test_perf_profiler_counts, "Test perf profiler counts"},
+{&test_perf_profiler_no_counters, "Test perf profiler with no counters"})
@@ -23,10 +23,7 @@ int test_range_itt()
 
     // Test range start and, next
     for (int i = 0; i < 100; i++) {
-        range_t range;
-        range.start = i;
-        range.end = END_FROM_START(i);
-        range.step = STEP;
+        range_t range = range_linear(i, END_FROM_START(i), STEP);
 
         range_start(&range);
         ASSERT(range.start == i);
@@ -64,9 +61,7 @@ static int test_mdd_range_itt()
     range_t *ranges = malloc(sizeof(*ranges) * DIMENSIONS);
     ASSERT(ranges != NULL);
     for (size_t d = 0; d < DIMENSIONS; d++) {
-        ranges[d].start = START;
-        ranges[d].end = END;
-        ranges[d].step = STEP;
+        ranges[d] = range_linear(START, END, STEP);
     }
 
     // test init and, next
@@ -102,10 +97,9 @@ static int test_mdd_range_itt_2()
     multi_dimensional_range_t range;
     memset(&range, 0, sizeof(range));
 
-    range_t range_1, range_2, range_3;
-    range_1.start = range_2.start = range_3.start = 1;
-    range_1.end = range_2.end = range_3.end = 3;
-    range_1.step = range_2.step = range_3.step = 1;
+    range_t range_1 = range_linear(1, 3, 1);
+    range_t range_2 = range_linear(1, 3, 1);
+    range_t range_3 = range_linear(1, 3, 1);
 
     init_multi_dimensional_range(&range, range_1, range_2, range_3);
     ASSERT(range.dimensions == 3);
@@ -131,6 +125,202 @@ static int test_mdd_range_itt_2()
     return 1;
 }
 
+static int test_mdd_range_at()
+{
+    multi_dimensional_range_t range;
+    memset(&range, 0, sizeof(range));
+
+    range_t range_1 = range_linear(1, 3, 1);
+    range_t range_2 = range_linear(0, 1, 0.1);
+
+    init_multi_dimensional_range(&range, range_1, range_2);
+    ASSERT(range_len(&range_1) == 3);
+    ASSERT(range_len(&range_2) == 11);
+    ASSERT(multi_dimensional_range_len(&range) == 3 * 11);
+
+    // The iteration and, the direct computation must agree, without allocating
+    multi_dimensional_range_start(&range);
+    double values[2], at[2];
+    for (size_t i = 0; i < 3 * 11; i++) {
+        ASSERT(multi_dimensional_range_next_into(&range, values) == RANGE_GENERATING);
+        ASSERT(multi_dimensional_range_at(&range, i, at));
+        ASSERT(values[0] == at[0]);
+        ASSERT(values[1] == at[1]);
+        ASSERT(D_EQUALS(values[0], 1 + i / 11));
+    }
+    ASSERT(multi_dimensional_range_next_into(&range, values) == RANGE_STOPPED);
+    ASSERT(!multi_dimensional_range_at(&range, 3 * 11, at));
+
+    // The last dimension changes the fastest
+    ASSERT(multi_dimensional_range_at(&range, 12, at));
+    ASSERT(at[0] == 2);
+    ASSERT(D_EQUALS(at[1], 0.1));
+
+    free_multi_dimensional_range(&range);
+    return 1;
+}
+
+static int test_range_kinds()
+{
+    // Powers of two
+    range_t range = range_geometric(1, 1024, 2);
+    ASSERT(range_len(&range) == 11);
+    for (size_t i = 0; i < 11; i++) {
+        ASSERT(range_value_at(&range, i) == (double) (1 << i));
+    }
+
+    double output;
+    range_start(&range);
+    ASSERT(range.current == 1);
+    for (size_t i = 1; i < 11; i++) {
+        ASSERT(range_next(&range, &output) == RANGE_GENERATING);
+        ASSERT(output == (double) (1 << i));
+    }
+    ASSERT(range_next(&range, &output) == RANGE_STOPPED);
+
+    // Log spaced, the ends are exact
+    range = range_log(10, 100000, 5);
+    ASSERT(range_len(&range) == 5);
+    ASSERT(range_value_at(&range, 0) == 10);
+    ASSERT(D_EQUALS(round(range_value_at(&range, 2)), 1000));
+    ASSERT(range_value_at(&range, 4) == 100000);
+
+    // Whole numbers
+    range = range_integer(3, 100, 7);
+    ASSERT(range_len(&range) == 14);
+    ASSERT(range_value_at(&range, 13) == 94);
+
+    // Hand picked values
+    double sizes[] = {32 * 1024, 256 * 1024, 8 * 1024 * 1024};
+    range = range_list(sizes, sizeof(sizes) / sizeof(*sizes));
+    ASSERT(range_len(&range) == 3);
+    ASSERT(range_value_at(&range, 1) == 256 * 1024);
+
+    // Linear ranges do not drift
+    range = range_linear(0, 1, 0.1);
+    ASSERT(range_len(&range) == 11);
+    range_start(&range);
+    for (size_t i = 1; i < 11; i++) {
+        ASSERT(range_next(&range, &output) == RANGE_GENERATING);
+        ASSERT(output == 0.1 * i);
+    }
+    ASSERT(range_next(&range, &output) == RANGE_STOPPED);
+
+    // Kinds can be mixed in a multi dimensional range
+    multi_dimensional_range_t mdd;
+    ASSERT(init_multi_dimensional_range(&mdd, range_geometric(1, 8, 2), range_list(sizes, 3)));
+    ASSERT(multi_dimensional_range_len(&mdd) == 4 * 3);
+    double values[2];
+    ASSERT(multi_dimensional_range_at(&mdd, 11, values));
+    ASSERT(values[0] == 8);
+    ASSERT(values[1] == 8 * 1024 * 1024);
+    free_multi_dimensional_range(&mdd);
+
+    // range_linear sets every field, as does a zeroed range
+    range = range_linear(1, 3, 1);
+    ASSERT(range.kind == RANGE_LINEAR);
+    ASSERT(range.count == 0);
+    ASSERT(range.values == NULL);
+    ASSERT(range_len(&range) == 3);
+    ASSERT(range_value_at(&range, 2) == 3);
+    memset(&range, 0, sizeof(range));
+    ASSERT(range.kind == RANGE_LINEAR);
+    return 1;
+}
+
+/// Checks that each value of each dimension was picked once
+static int sampled_once_each(multi_dimensional_range_t *range, size_t len)
+{
+    size_t seen[range->dimensions][len];
+    memset(seen, 0, sizeof(seen));
+
+    double values[range->dimensions];
+    multi_dimensional_range_start(range);
+    while (multi_dimensional_range_next_into(range, values) == RANGE_GENERATING) {
+        for (size_t d = 0; d < range->dimensions; d++) {
+            seen[d][(size_t) values[d]]++;
+        }
+    }
+
+    for (size_t d = 0; d < range->dimensions; d++) {
+        for (size_t i = 0; i < len; i++) {
+            ASSERT(seen[d][i] == 1);
+        }
+    }
+    return 1;
+}
+
+static int test_mdd_range_sampling()
+{
+    multi_dimensional_range_t range;
+    ASSERT(init_multi_dimensional_range(&range, range_integer(0, 7, 1), range_integer(0, 7, 1),
+                                        range_integer(0, 7, 1)));
+    ASSERT(multi_dimensional_range_len(&range) == 8 * 8 * 8);
+
+    // Random samples are reproducible and, on the grid
+    ASSERT(multi_dimensional_range_sample(&range, SAMPLE_RANDOM, 100, 42));
+    ASSERT(multi_dimensional_range_len(&range) == 100);
+    double a[3], b[3];
+    multi_dimensional_range_start(&range);
+    for (size_t i = 0; i < 100; i++) {
+        ASSERT(multi_dimensional_range_next_into(&range, a) == RANGE_GENERATING);
+        ASSERT(multi_dimensional_range_at(&range, i, b));
+        for (size_t d = 0; d < 3; d++) {
+            ASSERT(a[d] == b[d]);
+            ASSERT(a[d] >= 0 && a[d] <= 7 && a[d] == floor(a[d]));
+        }
+    }
+    ASSERT(multi_dimensional_range_next_into(&range, a) == RANGE_STOPPED);
+
+    // The stratified samplers use each value once when there are as many samples as values
+    ASSERT(multi_dimensional_range_sample(&range, SAMPLE_LATIN_HYPERCUBE, 8, 42));
+    ASSERT(sampled_once_each(&range, 8));
+    ASSERT(multi_dimensional_range_sample(&range, SAMPLE_SOBOL, 8, 0));
+    ASSERT(sampled_once_each(&range, 8));
+    ASSERT(multi_dimensional_range_sample(&range, SAMPLE_HALTON, 8, 0));
+    ASSERT(multi_dimensional_range_at(&range, 0, a));
+    ASSERT(a[0] == 4);
+
+    // Back to the full grid
+    ASSERT(multi_dimensional_range_sample(&range, SAMPLE_GRID, 0, 0));
+    ASSERT(multi_dimensional_range_len(&range) == 8 * 8 * 8);
+    free_multi_dimensional_range(&range);
+
+    // Sobol has a limited number of dimensions
+    range_t ranges[SOBOL_MAX_DIMENSIONS + 1];
+    for (size_t i = 0; i < SOBOL_MAX_DIMENSIONS + 1; i++) {
+        ranges[i] = range_linear(0, 1, 1);
+    }
+    ASSERT(init_multi_dimensional_range_arr(&range, SOBOL_MAX_DIMENSIONS + 1, ranges));
+    ASSERT(!multi_dimensional_range_sample(&range, SAMPLE_SOBOL, 8, 0));
+    ASSERT(multi_dimensional_range_sample(&range, SAMPLE_HALTON, 8, 0));
+    free_multi_dimensional_range(&range);
+    return 1;
+}
+
+static int test_param_arena()
+{
+    param_arena_t arena;
+    ASSERT(init_param_arena(&arena, 10));
+    double *a = param_arena_alloc(&arena, 4);
+    double *b = param_arena_alloc(&arena, 6);
+    ASSERT(a != NULL);
+    ASSERT(b == a + 4);
+    ASSERT(param_arena_alloc(&arena, 1) == NULL);
+    free_param_arena(&arena);
+    ASSERT(arena.values == NULL);
+
+    // Empty arenas do not allocate
+    ASSERT(init_param_arena(&arena, 0));
+    ASSERT(param_arena_alloc(&arena, 1) == NULL);
+    free_param_arena(&arena);
+    return 1;
+}
+
 SUB_TEST(test_ranges, {&test_range_itt, "Test range itt"},
 {&test_mdd_range_itt, "Test multi dimensional range itt"},
-{&test_mdd_range_itt_2, "Test multi dimensional range itt with other init method"})
+{&test_mdd_range_itt_2, "Test multi dimensional range itt with other init method"},
+{&test_mdd_range_at, "Test multi dimensional range index to vector"},
+{&test_range_kinds, "Test range kinds"},
+{&test_mdd_range_sampling, "Test multi dimensional range sampling"},
+{&test_param_arena, "Test param arena"})
@@ -3,11 +3,24 @@
 #include "./test_bench.h"
 #include "./test_mem_profiler.h"
 #include "./test_bench_output.h"
+#include "./test_histogram.h"
+#include "./test_perf_profiler.h"
+#include "./test_alloc_tracker.h"
+#include "./test_bench_compare.h"
+#include "./test_bench_registry.h"
+#include "./test_bench_env.h"
 
 SUB_TEST(all_tests, {&test_ranges, "Test Ranges"},
 {&test_bench, "Test benchmarking"},
 {&test_memory_profiler, "Test memory profiler"},
-{&test_bench_output, "Test benchmarking output"})
+{&test_cpu_profiler, "Test cpu profiler"},
+{&test_bench_output, "Test benchmarking output"},
+{&test_histogram, "Test histogram"},
+{&test_perf_profiler, "Test perf profiler"},
+{&test_alloc_tracker, "Test alloc tracker"},
+{&test_bench_compare, "Test benchmark comparison"},
+{&test_bench_registry, "Test benchmark registry"},
+{&test_bench_env, "Test benchmark environment"})
 
 int main()
 {
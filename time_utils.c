@@ -1,25 +1,91 @@
 #include "./time_utils.h"
+#include "./testing.h/logger.h"
 #include <stdlib.h>
 
-long time_diff(struct timeval x, struct timeval y)
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/// How long the TSC is measured against the monotonic clock for
+#define TSC_CALIBRATION_NS (20 * 1000 * 1000)
+
+long time_diff(struct timeval a, struct timeval b)
+{
+    return (b.tv_sec - a.tv_sec) * (1000 * 1000) + (b.tv_usec - a.tv_usec);
+}
+
+int64_t time_diff_ns(struct timespec a, struct timespec b)
+{
+    return (int64_t) (b.tv_sec - a.tv_sec) * (1000 * 1000 * 1000) + (b.tv_nsec - a.tv_nsec);
+}
+
+uint64_t time_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * (1000 * 1000 * 1000) + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/// Checks CPUID.80000007H:EDX[8], without it the TSC rate changes with the core frequency
+static int has_invariant_tsc()
 {
-    // Source https://www.gnu.org/software/libc/manual/html_node/Calculating-Elapsed-Time.html
-    /* Perform the carry for the later subtraction by updating y. */
-    if (x.tv_usec < y.tv_usec) {
-        int nsec = (y.tv_usec - x.tv_usec) / 1000000 + 1;
-        y.tv_usec -= 1000000 * nsec;
-        y.tv_sec += nsec;
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return 0;
     }
-    if (x.tv_usec - y.tv_usec > 1000000) {
-        int nsec = (x.tv_usec - y.tv_usec) / 1000000;
-        y.tv_usec += 1000000 * nsec;
-        y.tv_sec -= nsec;
+    return (edx & (1 << 8)) != 0;
+}
+
+static double calibrate_tsc()
+{
+    unsigned int aux;
+    uint64_t start_ns = time_now_ns();
+    uint64_t start_tsc = __rdtscp(&aux);
+
+    uint64_t now_ns;
+    do {
+        now_ns = time_now_ns();
+    } while (now_ns - start_ns < TSC_CALIBRATION_NS);
+
+    uint64_t end_tsc = __rdtscp(&aux);
+    now_ns = time_now_ns();
+
+    if (end_tsc <= start_tsc) {
+        return 0;
     }
+    return (double) (now_ns - start_ns) / (double) (end_tsc - start_tsc);
+}
+#endif
+
+int init_benchmark_timer(benchmark_timer_t *timer, benchmark_timer_type_t type)
+{
+    timer->type = TIMER_MONOTONIC;
+    timer->ns_per_tick = 1;
 
-    /* Compute the time remaining to wait.
-       tv_usec is certainly positive. */
-    long tv_sec = x.tv_sec - y.tv_sec;
-    long tv_usec = x.tv_usec - y.tv_usec;
+    switch (type) {
+    case TIMER_MONOTONIC:
+        return 1;
+    case TIMER_RDTSCP:
+#if defined(__x86_64__) || defined(__i386__)
+        if (!has_invariant_tsc()) {
+            lprintf(LOG_WARNING, "The TSC is not invariant, using the monotonic clock\n");
+            return 1;
+        }
+
+        timer->ns_per_tick = calibrate_tsc();
+        if (timer->ns_per_tick <= 0) {
+            lprintf(LOG_WARNING, "Cannot calibrate the TSC, using the monotonic clock\n");
+            timer->ns_per_tick = 1;
+            return 1;
+        }
+        timer->type = TIMER_RDTSCP;
+#else
+        lprintf(LOG_WARNING, "rdtscp is not supported on this platform, using the monotonic clock\n");
+#endif
+        return 1;
+    }
 
-    return labs(tv_usec + (1000 * 1000) * tv_sec);
+    lprintf(LOG_ERROR, "Invalid timer type\n");
+    return 0;
 }
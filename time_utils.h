@@ -1,7 +1,70 @@
 #pragma once
 #include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /// The difference in time between a and, b
 /// returns b - a in micro seconds (us)
 long time_diff(struct timeval a, struct timeval b);
 
+/// The difference in time between a and, b
+/// returns b - a in nano seconds (ns)
+int64_t time_diff_ns(struct timespec a, struct timespec b);
+
+/// Reads CLOCK_MONOTONIC_RAW in ns, this is not affected by NTP steps or, slewing
+uint64_t time_now_ns();
+
+/// Different clocks that runs can be timed with
+typedef enum benchmark_timer_type_t {
+    /// clock_gettime(CLOCK_MONOTONIC_RAW), the default
+    TIMER_MONOTONIC,
+    /// rdtscp calibrated against CLOCK_MONOTONIC_RAW, falls back to TIMER_MONOTONIC
+    /// if the cpu does not have an invariant TSC
+    TIMER_RDTSCP
+} benchmark_timer_type_t;
+
+/// A calibrated timer, use init_benchmark_timer
+typedef struct benchmark_timer_t {
+    benchmark_timer_type_t type;
+    /// ns per tick for TIMER_RDTSCP, 1 for TIMER_MONOTONIC
+    double ns_per_tick;
+} benchmark_timer_t;
+
+/// Inits a timer, calibrating the TSC if it is used
+int init_benchmark_timer(benchmark_timer_t *timer, benchmark_timer_type_t type);
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Reads the timer in ticks, use benchmark_timer_ns to convert the difference between two reads
+static inline uint64_t benchmark_timer_read(benchmark_timer_t *timer)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (timer->type == TIMER_RDTSCP) {
+        unsigned int aux;
+        return __rdtscp(&aux);
+    }
+#endif
+    return time_now_ns();
+}
+
+/// Converts the ticks between two reads of a timer into ns
+static inline uint64_t benchmark_timer_ns(benchmark_timer_t *timer, uint64_t start, uint64_t end)
+{
+    if (end < start) {
+        return 0;
+    }
+    if (timer->type == TIMER_MONOTONIC) {
+        return end - start;
+    }
+    return (uint64_t) ((end - start) * timer->ns_per_tick);
+}
+
+#ifdef __cplusplus
+}
+#endif